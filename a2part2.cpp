@@ -12,8 +12,27 @@
 #include <TouchScreen.h>
 #include <Adafruit_GFX.h>
 #include "lcd_image.h"
+#include "menu.h"
+#include "sdcard.h"
+#include "sdstream.h"
 #include "yegmap.h"
 #include "restaurant.h"
+#include "listcache.h"
+#include "namesearch.h"
+#include "tiles.h"
+#include "scheduler.h"
+#include "joystick.h"
+#include "trace.h"
+#include "iostats.h"
+#include "inputlog.h"
+#include "sram.h"
+
+// serial rate, raised when recording the input so it can keep up
+#ifdef RECORD_INPUT
+#define SERIAL_BAUD INPUT_LOG_BAUD
+#else
+#define SERIAL_BAUD 9600
+#endif
 
 // SD_CS pin for SD card reader
 #define SD_CS 10
@@ -32,11 +51,6 @@
 #define DISP_WIDTH (TFT_WIDTH - RATING_SIZE)
 #define DISP_HEIGHT TFT_HEIGHT
 
-// constants for the joystick
-#define JOY_DEADZONE 64
-#define JOY_CENTRE 512
-#define JOY_STEPS_PER_PIXEL 64
-
 // touch screen pins, obtained from the documentaion
 #define YP A3  // must be an analog pin, use "An" notation!
 #define XM A2  // must be an analog pin, use "An" notation!
@@ -54,11 +68,50 @@
 #define MINPRESSURE  100
 #define MAXPRESSURE 1000
 
+// milliseconds before another touch is accepted, the plate is noisy
+#define TOUCH_DEBOUNCE 200
+
+// scheduling of the main loop: how often input is sampled and handled,
+// how long the menu waits between moves and the time budgets of the
+// background work
+#define INPUT_PERIOD 10
+#define FRAME_PERIOD 30
+#define MENU_SCROLL_PERIOD 50
+#define RENDER_BUDGET 20
+#define LIST_BUDGET 20
+
+// buttons on the right side of the display, from top to bottom
+#define NUM_BUTTONS 5
+#define BUTTON_HEIGHT (DISP_HEIGHT/NUM_BUTTONS)
+enum Button { RATING_BUTTON, SORT_BUTTON, METRIC_BUTTON, ZOOM_BUTTON, FIND_BUTTON };
+
+// spacing of the characters printed down a button, one row less than a
+// character at size 2 so four of them fit with the border
+#define LABEL_PITCH 15
+
+// keyboard of the name search, filling the bottom of the display: a run of
+// the same key in a row is one wide key
+#define KEY_COLS 10
+#define KEY_ROWS 5
+#define KEY_WIDTH (TFT_WIDTH/KEY_COLS)
+#define KEY_HEIGHT 40
+#define KEYBOARD_TOP (TFT_HEIGHT - KEY_ROWS*KEY_HEIGHT)
+#define KEY_DELETE '\b'
+#define KEY_EXIT '\x1b'
+
+// matches of the name search listed between the name typed and the keyboard
+#define SEARCH_ROWS 6
+#define MATCH_TOP 20
+
 // Cursor size. For best results, use an odd number.
 #define CURSOR_SIZE 9
 
+// radius of the marker drawn for a single restaurant and for a cluster
+#define DOT_RADIUS 3
+#define CLUSTER_RADIUS 8
+
 // number of restaurants to display
-#define REST_DISP_NUM 21
+#define REST_DISP_NUM REST_PAGE_SIZE
 
 // ********** BEGIN GLOBAL VARIABLES ************
 MCUFRIEND_kbv tft;
@@ -68,24 +121,25 @@ Sd2Card card;
 // so initialize with this to get more accurate readings.
 TouchScreen ts = TouchScreen(XP, YP, XM, YM, 300);
 
-// The currently selected restaurant, if we are in mode 1.
-// It's arguable if this needs to be a global variable, but we'll let this
-// be one of the "few" that are allowed. As long as we don't clutter the global
-// space with too many variables.
-int selectedRest;
+// The position in the sorted list of the restaurant in the top row of the
+// menu, if we are in mode 1. It's arguable if this needs to be a global
+// variable, but we'll let this be one of the "few" that are allowed. As long
+// as we don't clutter the global space with too many variables.
+int menuTop;
 
 // overall restaurant index in sorted list
 int overallIndex;
 
-// rating and sort selector variables
+// rating, sort and distance metric selector variables
 int rating = 1;
 int sortMode = 0;
+int metric = MANHATTAN;
 
 // sets number of restaurants to pull from list
 int relevantRestaurants = NUM_RESTAURANTS;
 
 // which mode are we in?
-enum DisplayMode { MAP, MENU } displayMode;
+enum DisplayMode { MAP, MENU, SEARCH } displayMode;
 
 // the current map view and the previous one from last cursor movement
 MapView curView, preView;
@@ -94,27 +148,82 @@ MapView curView, preView;
 // information for the most recent click in sorted order.
 RestDist restaurants[NUM_RESTAURANTS];
 
-// edmonton map
-lcd_image_t edmontonBig = { "yeg-big.lcd", MAPWIDTH, MAPHEIGHT };
+// Progress of building restaurants[] in the background, and whether the
+// first page of the menu has been drawn from it yet.
+ListBuild build;
+bool menuShown;
+
+// The first pages of the lists built most recently, and the card failures
+// (see sdcard.h) when the current build started, so a page read from a
+// failing card is not kept.
+ListCache listCache;
+uint16_t buildFailures;
+
+// edmonton map pyramid, one image per zoom level
+lcd_image_t edmonton[NUM_ZOOM_LEVELS] = {
+	{ "yeg-big.lcd", MAPWIDTH_AT(0), MAPHEIGHT_AT(0) },
+	{ "yeg-mid.lcd", MAPWIDTH_AT(1), MAPHEIGHT_AT(1) },
+	{ "yeg-sml.lcd", MAPWIDTH_AT(2), MAPHEIGHT_AT(2) }
+};
 
 // The cache of 8 restaurants for the getRestaurant function.
 RestCache cache;
 
+// Whether the card holds the marker table the markers are drawn from.
+bool markersFound;
+
+// The map being drawn to the display a few rows at a time.
+lcd_image_job_t mapJob;
+
+// The joystick, sampled by the input task.
+Joystick joy;
+
+// Latest touch sampled by the input task, latched until the mode that is
+// active consumes it.
+struct {
+	bool touched;           // touchscreen was pressed at (touchX, touchY)
+	int touchX, touchY;
+	uint32_t lastTouch;     // millis() of the last accepted touch
+} input;
+
+// millis() of the last move through the menu
+uint32_t lastMenuMove;
+
+// The keys of the keyboard, by row from the top.
+const char keys[KEY_ROWS][KEY_COLS + 1] PROGMEM = {
+	"1234567890",
+	"QWERTYUIOP",
+	"ASDFGHJKL'",
+	"ZXCVBNM&-.",
+	"\b\b      \x1b\x1b"
+};
+
+// The start of the name typed on the keyboard, and the restaurants whose
+// names start with it.
+struct {
+	char query[NAME_PREFIX + 1];
+	uint8_t length;
+	int16_t first;      // position of the first match in the name index, or NAME_NO_INDEX
+	int8_t count;       // number of matches listed
+	int8_t selected;    // match highlighted
+} search;
+
 // ************ END GLOBAL VARIABLES ***************
 
 // Forward declaration of functions to begin the modes. Setup uses one, so
 // it seems natural to forward declare both (not really that important).
 void beginMode0();
 void beginMode1();
+void beginSearch();
 void buttons();
 
 void setup() {
 	init();
 
-	Serial.begin(9600);
+	Serial.begin(SERIAL_BAUD);
 
-	// joystick button initialization
-	pinMode(JOY_SEL, INPUT_PULLUP);
+	// joystick initialization
+	joystickInit(&joy, JOY_VERT_ANALOG, JOY_HORIZ_ANALOG, JOY_SEL);
 
 	// tft display initialization
 	uint16_t ID = tft.readID();
@@ -123,30 +232,48 @@ void setup() {
 	tft.setTextWrap(false);
 
 	// now initialize the SD card in both modes
-    Serial.print("Initializing SD card...");
-
-	// Initialize for reading through the FAT filesystem
-	// (required for lcd_image drawing function).
-    if (!SD.begin(SD_CS)) {
-    	Serial.println("failed!");
-    	Serial.println("Is the card inserted properly?");
+	// First for raw reads, at the fastest clock that reads the first blocks
+	// of restaurants back correctly.
+    Serial.print(F("Initializing SPI communication for raw reads..."));
+    if (!cardBegin(&card, SD_CS, REST_START_BLOCK, (uint8_t*) cache.block)) {
+    	Serial.println(F("failed!"));
     	while (true) {}
     }
 
-	// Also initialize the SD card for raw reads.
-    Serial.print("Initializing SPI communication for raw reads...");
-    if (!card.init(SPI_HALF_SPEED, SD_CS)) {
-    	Serial.println("failed!");
+    Serial.print(F("OK! SPI clock "));
+    Serial.println(cardClock());
+
+    // Draw the map by streaming it from the card where its files allow,
+    // rather than seeking through the file system for every row. The files
+    // are found before the SD library is started, since finding them binds
+    // the volume cache the SD library shares to the raw card (see
+    // streamLocate()), and SD.begin() binds it back.
+    streamInit(SD_CS);
+    for (int z = 0; z < NUM_ZOOM_LEVELS; z++) {
+    	if (!lcd_image_locate(&edmonton[z], &card)) {
+    		Serial.print(edmonton[z].file_name);
+    		Serial.println(F(" is not in consecutive blocks, reading it through the files"));
+    	}
+    }
+
+	// Then for reading through the FAT filesystem
+	// (required for lcd_image drawing function).
+    Serial.print(F("Initializing SD card..."));
+    if (!SD.begin(SD_CS)) {
+    	Serial.println(F("failed!"));
+    	Serial.println(F("Is the card inserted properly?"));
     	while (true) {}
     }
 
-    Serial.println("OK!");
+    // SD.begin() set the card to its own clock, so set the raw reads' again
+    card.setSckRate(cardRate());
 
     // initial cursor position is the centre of the screen
     curView.cursorX = DISP_WIDTH/2;
     curView.cursorY = DISP_HEIGHT/2;
 
-	  // initial map position is the middle of Edmonton
+	  // initial map position is the middle of Edmonton, at full size
+	  curView.zoom = 0;
 	  curView.mapX = ((MAPWIDTH / DISP_WIDTH)/2) * DISP_WIDTH;
 	  curView.mapY = ((MAPHEIGHT / DISP_HEIGHT)/2) * DISP_HEIGHT;
 
@@ -154,6 +281,14 @@ void setup() {
 		// will start at REST_START_BLOCK, which is 4000000.
 		cache.cachedBlock = 0;
 
+		// Without the marker table only the map is drawn.
+		markersFound = markerTableFound(&card, &cache);
+		if (!markersFound) {
+			Serial.println(F("No marker table on the card"));
+		}
+
+		listCacheClear(&listCache);
+
 		// will draw the initial map screen and other stuff on the display
 	  beginMode0();
 }
@@ -169,7 +304,12 @@ void setup() {
 		None
 */
 void moveCursor() {
-	lcd_image_draw(&edmontonBig, &tft,
+	// the cursor is drawn once the map has been, see renderTask()
+	if (lcd_image_job_active(&mapJob)) {
+		return;
+	}
+
+	lcd_image_draw(&edmonton[preView.zoom], &tft,
 								 preView.mapX + preView.cursorX - CURSOR_SIZE/2,
 							 	 preView.mapY + preView.cursorY - CURSOR_SIZE/2,
 							   preView.cursorX - CURSOR_SIZE/2, preView.cursorY - CURSOR_SIZE/2,
@@ -177,6 +317,7 @@ void moveCursor() {
 
 	tft.fillRect(curView.cursorX - CURSOR_SIZE/2, curView.cursorY - CURSOR_SIZE/2,
 							 CURSOR_SIZE, CURSOR_SIZE, TFT_RED);
+	IO_COUNT(tftBytes, 2 * CURSOR_SIZE * CURSOR_SIZE);
 }
 
 /*
@@ -191,51 +332,61 @@ void beginMode0() {
 	// Black out the rating selector part (less relevant in Assignment 1, but
 	// it is useful when you first start the program).
 	tft.fillRect(DISP_WIDTH, 0, RATING_SIZE, DISP_HEIGHT, TFT_BLACK);
+	IO_COUNT(tftBytes, 2L * RATING_SIZE * DISP_HEIGHT);
 
-	// Draw the current part of Edmonton to the tft display.
-  lcd_image_draw(&edmontonBig, &tft,
-								 curView.mapX, curView.mapY,
-								 0, 0,
-								 DISP_WIDTH, DISP_HEIGHT);
+	// Start drawing the current part of Edmonton to the tft display,
+	// the cursor is drawn on top of it when it is done.
+  lcd_image_job_start(&mapJob, &edmonton[curView.zoom],
+											curView.mapX, curView.mapY,
+											0, 0,
+											DISP_WIDTH, DISP_HEIGHT);
 
   buttons();
 
-	// just the initial draw of the cursor on the map
-	moveCursor();
-
   displayMode = MAP;
 }
 
-/* 
-	Print the i'th restaurant in the sorted list. Modified from existing part 1 solution to 
-	account for i > 21. 
+/*
+	Makes sure the first n restaurants of the sorted list are in their final
+	order, finishing the list build right away if they are not.
+
+	Arguments:
+		n (int): number of restaurants needed
+
+	Returns:
+		None
+*/
+void waitForList(int n) {
+	if (!listReady(&build, n)) {
+		stepList(&build, restaurants, &card, &cache, NO_BUDGET);
+	}
+}
+
+/*
+	Show the restaurant at the given position of the sorted list in a row of
+	the menu.
 
 	Arguments:
+		row (int): row of the menu
 		i (int): index of restaurant in sorted list
 
 	Returns:
 		None
 */
-void printRestaurant(int i) {
+void showRestaurant(int row, int i) {
+	TRACE_SCOPE(TRACE_PRINT_RESTAURANT);
 	restaurant r;
 
 	// get the i'th restaurant
-	getRestaurant(&r, restaurants[i].index, &card, &cache);
-
-	// Set its colour based on whether or not it is the selected restaurant.
-	if ((i % REST_DISP_NUM) != selectedRest) {
-		tft.setTextColor(TFT_WHITE, TFT_BLACK);
-	}
-	else {
-		tft.setTextColor(TFT_BLACK, TFT_WHITE);
-	}
-	tft.setCursor(0, (i%REST_DISP_NUM)*15);
-	tft.print(r.name);
+	waitForList(i + 1);
+	getRestaurant(&r, restIndex(restaurants[i]), &card, &cache);
+	menuSetRow(&tft, row, r.name);
 }
 
 /*
-	Begin mode 1 by sorting the restaurants around the cursor
-	and then displaying the list. Modified from existing part 1 solution.
+	Begin mode 1 by starting to sort the restaurants around the cursor. The
+	list is displayed by listTask() as soon as its first page is ready.
+	Modified from existing part 1 solution.
 
 	Arguments:
 		None
@@ -244,25 +395,41 @@ void printRestaurant(int i) {
 		None
 */
 void beginMode1() {
+	IO_BEGIN(IO_LIST);
+
+	// abandon any part of the map still to be drawn
+	mapJob.row = mapJob.height;
+
 	tft.setCursor(0, 0);
 	tft.fillScreen(TFT_BLACK);
+	IO_COUNT(tftBytes, 2L * TFT_WIDTH * TFT_HEIGHT);
 	tft.setTextSize(2);
 
-	// Get the RestDist information for this cursor position and sort it.
-	relevantRestaurants = getAndSortRestaurants(curView, restaurants, &card, &cache, rating, sortMode);
-
-	// Initially have the closest restaurant highlighted.
-	selectedRest = 0;
-
-	// initially overall restaurant index should be the same as selectedRest
-	overallIndex = 0;
+	// Start getting the RestDist information for this cursor position and
+	// sorting it, from the first page of the last list built here if it is
+	// cached.
+	startList(&build, curView, rating, sortMode, metric);
+	bool hit = listCacheStart(&listCache, &build, restaurants);
+	buildFailures = cardErrors.failures;
+	menuShown = false;
 
-	// Print the list of restaurants.
-	for (int i = 0; i < REST_DISP_NUM; ++i) {
-		printRestaurant(i);
+	if (hit) {
+		Serial.print(F("List cache hit ("));
+	} else {
+		Serial.print(F("List cache miss ("));
 	}
+	Serial.print(listCache.hits);
+	Serial.print(F(" hits, "));
+	Serial.print(listCache.misses);
+	Serial.println(F(" misses)"));
+
+	// Initially have the closest restaurant highlighted, in the top row of
+	// the cleared screen.
+	menuClear();
+	menuTop = 0;
+	overallIndex = 0;
 
-	displayMode = 1;
+	displayMode = MENU;
 }
 
 /*
@@ -279,7 +446,7 @@ void checkRedrawMap() {
 	bool scroll = false;
 
 	// If we nudged the left or right edge, shift the map over.
-	if (curView.cursorX == DISP_WIDTH-CURSOR_SIZE/2-1 && curView.mapX != MAPWIDTH - DISP_WIDTH) {
+	if (curView.cursorX == DISP_WIDTH-CURSOR_SIZE/2-1 && curView.mapX != MAPWIDTH_AT(curView.zoom) - DISP_WIDTH) {
 		curView.mapX += DISP_WIDTH;
 		curView.cursorX = DISP_WIDTH/2;
 		scroll = true;
@@ -291,7 +458,7 @@ void checkRedrawMap() {
 	}
 
 	// If we nudged the top or bottom edge, shift the map up or down.
-	if (curView.cursorY == DISP_HEIGHT-CURSOR_SIZE/2-1 && curView.mapY != MAPHEIGHT - DISP_HEIGHT) {
+	if (curView.cursorY == DISP_HEIGHT-CURSOR_SIZE/2-1 && curView.mapY != MAPHEIGHT_AT(curView.zoom) - DISP_HEIGHT) {
 		curView.mapY += DISP_HEIGHT;
 		curView.cursorY = DISP_HEIGHT/2;
 		scroll = true;
@@ -304,16 +471,112 @@ void checkRedrawMap() {
 
 	// If we nudged the edge, recalculate and draw the new rectangular portion of Edmonton to display.
 	if (scroll) {
+		IO_BEGIN(IO_SCROLL);
+
 		// Make sure we didn't scroll outside of the map.
-		curView.mapX = constrain(curView.mapX, 0, MAPWIDTH - DISP_WIDTH);
-		curView.mapY = constrain(curView.mapY, 0, MAPHEIGHT - DISP_HEIGHT);
+		curView.mapX = constrain(curView.mapX, 0, MAPWIDTH_AT(curView.zoom) - DISP_WIDTH);
+		curView.mapY = constrain(curView.mapY, 0, MAPHEIGHT_AT(curView.zoom) - DISP_HEIGHT);
+
+		lcd_image_job_start(&mapJob, &edmonton[curView.zoom], curView.mapX, curView.mapY, 0, 0, DISP_WIDTH, DISP_HEIGHT);
+	}
+}
+
+/*
+	Switches the map to the given level of the pyramid, keeping the point
+	under the cursor centred on the screen where the edges of the map allow,
+	and redraws the map.
+
+	Arguments:
+		zoom (uint8_t): new zoom level, 0 being the full size map
+
+	Returns:
+		None
+*/
+void setZoom(uint8_t zoom) {
+	// position of the cursor on the map at the new zoom level
+	int16_t x = rezoom(curView.mapX + curView.cursorX, curView.zoom, zoom);
+	int16_t y = rezoom(curView.mapY + curView.cursorY, curView.zoom, zoom);
+
+	curView.zoom = zoom;
+	curView.mapX = constrain(x - DISP_WIDTH/2, 0, MAPWIDTH_AT(zoom) - DISP_WIDTH);
+	curView.mapY = constrain(y - DISP_HEIGHT/2, 0, MAPHEIGHT_AT(zoom) - DISP_HEIGHT);
+	curView.cursorX = constrain(x - curView.mapX, CURSOR_SIZE/2, DISP_WIDTH-CURSOR_SIZE/2-1);
+	curView.cursorY = constrain(y - curView.mapY, CURSOR_SIZE/2, DISP_HEIGHT-CURSOR_SIZE/2-1);
+
+	preView = curView;
+
+	beginMode0();
+}
+
+/*
+	Draws the marker of a tile: a dot where it holds a single restaurant, and
+	a circle labelled with the number of restaurants at their mean position
+	otherwise, if the entire marker will be in the map display.
+
+	Arguments:
+		x (int16_t): position of the marker, in pixels of the map at the zoom level
+		y (int16_t): likewise
+		count (uint16_t): number of restaurants of the tile
+		ctx (void*): pointer to the MapView drawn
 
-		lcd_image_draw(&edmontonBig, &tft, curView.mapX, curView.mapY, 0, 0, DISP_WIDTH, DISP_HEIGHT);
+	Returns:
+		None
+*/
+static void drawMarker(int16_t x, int16_t y, uint16_t count, void* ctx) {
+	const MapView* mv = (const MapView*) ctx;
+	x -= mv->mapX;
+	y -= mv->mapY;
+	int16_t radius = (count == 1) ? DOT_RADIUS : CLUSTER_RADIUS;
+
+	if (x < radius || x >= DISP_WIDTH-radius || y < radius || y >= DISP_HEIGHT-radius) {
+		return;
+	}
+
+	tft.fillCircle(x, y, radius, TFT_BLUE);
+	if (count > 1) {
+		// characters are 6x8 pixels at size 1
+		int digits = (count < 10) ? 1 : (count < 100 ? 2 : (count < 1000 ? 3 : 4));
+		tft.setCursor(x - 3*digits + 1, y - 3);
+		tft.print(count);
 	}
 }
 
 /*
-	Process joystick and touchscreen input when in mode 0. Taken from part1 solution.
+	Draws a marker for every tile of the map in view, from the marker table
+	on the card. The tiles are the same size on the screen at every zoom
+	level, so the markers merge within the same distance, and the cost of
+	drawing depends on the area of the screen rather than on the number of
+	restaurants.
+
+	Arguments:
+		None
+
+	Returns:
+		None
+*/
+void drawClusters() {
+	// the markers go on top of the map, so it has to be finished first
+	if (lcd_image_job_active(&mapJob)) {
+		lcd_image_job_step(&mapJob, &tft, NO_BUDGET);
+		preView = curView;
+		moveCursor();
+	}
+
+	if (!markersFound) {
+		return;
+	}
+
+	tft.setTextSize(1);
+	tft.setTextColor(TFT_WHITE, TFT_BLUE);
+
+	MapView mv = curView;
+	getTileMarkers(mv, DISP_WIDTH, DISP_HEIGHT, rating, drawMarker, &mv, &card, &cache);
+}
+
+/*
+	Process joystick and touchscreen input when in mode 0. The cursor takes
+	all the joystick motion sampled since the last frame at once. Taken from
+	part1 solution.
 
 	Arguments:
 		None
@@ -322,28 +585,24 @@ void checkRedrawMap() {
 		None
 */
 void scrollingMap() {
-  int v = analogRead(JOY_VERT_ANALOG);
-  int h = analogRead(JOY_HORIZ_ANALOG);
-  int invSelect = digitalRead(JOY_SEL);
+  int16_t dx, dy;
+  joystickTakeMotion(&joy, &dx, &dy);
 
 	// A flag to indicate if the cursor moved or not.
 	bool cursorMove = false;
 
   // If there was vertical movement, then move the cursor.
-  if (abs(v - JOY_CENTRE) > JOY_DEADZONE) {
-    // First move the cursor.
-    int delta = (v - JOY_CENTRE) / JOY_STEPS_PER_PIXEL;
+  if (dy != 0) {
 		// Clamp it so it doesn't go outside of the screen.
-    curView.cursorY = constrain(curView.cursorY + delta, CURSOR_SIZE/2, DISP_HEIGHT-CURSOR_SIZE/2-1);
+    curView.cursorY = constrain(curView.cursorY + dy, CURSOR_SIZE/2, DISP_HEIGHT-CURSOR_SIZE/2-1);
 		// And now see if it actually moved.
 		cursorMove |= (curView.cursorY != preView.cursorY);
   }
 
 	// If there was horizontal movement, then move the cursor.
-  if (abs(h - JOY_CENTRE) > JOY_DEADZONE) {
+  if (dx != 0) {
     // Ideas are the same as the previous if statement.
-    int delta = -(h - JOY_CENTRE) / JOY_STEPS_PER_PIXEL;
-    curView.cursorX = constrain(curView.cursorX + delta, CURSOR_SIZE/2, DISP_WIDTH-CURSOR_SIZE/2-1);
+    curView.cursorX = constrain(curView.cursorX + dx, CURSOR_SIZE/2, DISP_WIDTH-CURSOR_SIZE/2-1);
 		cursorMove |= (curView.cursorX != preView.cursorX);
   }
 
@@ -362,63 +621,77 @@ void scrollingMap() {
 	preView = curView;
 
 	// Did we click the joystick?
-  if(invSelect == LOW){
+  if (joystickTakeClick(&joy)) {
 		beginMode1();
     displayMode = MENU;
     Serial.println(displayMode);
-    Serial.println("MODE changed.");
-
-		// Just to make sure the restaurant is not selected by accident
-		// because the button was pressed too long.
-		while (digitalRead(JOY_SEL) == LOW) { delay(10); }
+    Serial.println(F("MODE changed."));
   }
 
-	// Check for touchscreen press and draws dots for each restaurant
-	TSPoint touch = ts.getPoint();
-
-	// Necessary to resume TFT display functions
-	pinMode(YP, OUTPUT);
-  	pinMode(XM, OUTPUT);
-
-	// If there was an actual touch, draw the dots
-	if (touch.z >= MINPRESSURE && touch.z <= MAXPRESSURE) {
-		// if the screen has been touched
-	    // map touch points to screen size
-	    int ptx = map(touch.y, TS_MINX, TS_MAXX, 0, TFT_WIDTH);
-        int pty = map(touch.x, TS_MINY, TS_MAXY, 0, TFT_HEIGHT);
+	// If there was an actual touch, draw the dots or press a button
+	if (input.touched) {
+		input.touched = false;
+		IO_BEGIN(IO_TAP);
+	    int ptx = input.touchX;
+        int pty = input.touchY;
         if (ptx > RATING_SIZE) {
         	// touch was in map range
-        	restaurant r;
-			// just iterate through all relevant restaurants (preferred rating) on the card
-			for (int i = 0; i < relevantRestaurants; ++i) {
-				getRestaurant(&r, i, &card, &cache);
-				int16_t rest_x_tft = lon_to_x(r.lon)-curView.mapX, rest_y_tft = lat_to_y(r.lat)-curView.mapY;
-
-				// only draw if entire radius-3 circle will be in the map display
-				if (rest_x_tft >= 3 && rest_x_tft < DISP_WIDTH-3 &&  rest_y_tft >= 3 && rest_y_tft < DISP_HEIGHT-3) {
-					tft.fillCircle(rest_x_tft, rest_y_tft, 3, TFT_BLUE);
-				}
-			}
-        } else if (ptx < RATING_SIZE && pty > (DISP_HEIGHT/2)) {
-        	// touch was on buttons
-        	rating++;
-        	rating = rating % 6;
-        	if (rating == 0) {
-        		// account for 6 % 6 = 0
-        		rating = 1;
+			drawClusters();
+        } else if (ptx < RATING_SIZE) {
+        	// touch was on buttons, which are stacked from the top of the
+        	// display while the touch y axis runs from the bottom
+        	int button = constrain((DISP_HEIGHT - 1 - pty) / BUTTON_HEIGHT, 0, NUM_BUTTONS - 1);
+        	if (button == RATING_BUTTON) {
+        		rating++;
+        		rating = rating % 6;
+        		if (rating == 0) {
+        			// account for 6 % 6 = 0
+        			rating = 1;
+        		}
+        		buttons();
+        	} else if (button == SORT_BUTTON) {
+        		sortMode ++;
+        		sortMode = sortMode % 3;
+        		buttons();
+        	} else if (button == METRIC_BUTTON) {
+        		metric = (metric + 1) % NUM_METRICS;
+        		buttons();
+        	} else if (button == ZOOM_BUTTON) {
+        		// cycle through the levels of the map pyramid, redrawing the map
+        		setZoom((curView.zoom + 1) % NUM_ZOOM_LEVELS);
+        	} else {
+        		beginSearch();
         	}
-        	buttons();
-        	delay(200);
-        } else if (ptx < RATING_SIZE && pty < (DISP_HEIGHT/2)) {
-        	sortMode ++;
-        	sortMode = sortMode % 3;
-        	buttons();
-        	delay(200);
         }
 		
 	}
 }
 
+/*
+	Returns to the map centred on a restaurant, with the cursor on it.
+
+	Arguments:
+		r (const restaurant&): pass-by-reference to the restaurant
+
+	Returns:
+		None
+*/
+void showOnMap(const restaurant& r) {
+	// Center the map view at the restaurant, constraining against the edge of
+	// the map if necessary.
+	int16_t x = lon_to_x(r.lon, curView.zoom), y = lat_to_y(r.lat, curView.zoom);
+	curView.mapX = constrain(x-DISP_WIDTH/2, 0, MAPWIDTH_AT(curView.zoom)-DISP_WIDTH);
+	curView.mapY = constrain(y-DISP_HEIGHT/2, 0, MAPHEIGHT_AT(curView.zoom)-DISP_HEIGHT);
+
+	// Draw the cursor, clamping to an edge of the map if needed.
+	curView.cursorX = constrain(x - curView.mapX, CURSOR_SIZE/2, DISP_WIDTH-CURSOR_SIZE/2-1);
+	curView.cursorY = constrain(y - curView.mapY, CURSOR_SIZE/2, DISP_HEIGHT-CURSOR_SIZE/2-1);
+
+	preView = curView;
+
+	beginMode0();
+}
+
 /*
 	Process joystick movement when in mode 1. Modified from part 1 solution to include overallIndex.
 	
@@ -429,84 +702,139 @@ void scrollingMap() {
 		None
 */
 void scrollingMenu() {
-	int oldRest = selectedRest;
+	// the map cursor does not move while the menu is open
+	int16_t dx, dy;
+	joystickTakeMotion(&joy, &dx, &dy);
+
+	// nothing to navigate until the first page is shown
+	if (!menuShown) {
+		joystickTakeClick(&joy);
+		return;
+	}
+
 	int overallIndexPrev = overallIndex;
 
-	int v = analogRead(JOY_VERT_ANALOG);
+	int v = joy.v;
+
+	// so we don't scroll too fast
+	if (millis() - lastMenuMove < MENU_SCROLL_PERIOD) {
+		v = JOY_CENTRE;
+	}
 
 	// if the joystick was pushed up or down, change restaurants accordingly.
-	if (v > JOY_CENTRE + JOY_DEADZONE) {
-		// increment overall index along with selectedRest so they always point to the same restaurant
-		++selectedRest;
+	if (v > JOY_CENTRE + JOY_DEADZONE && overallIndex < relevantRestaurants - 1) {
 		++overallIndex;
 	}
-	else if (v < JOY_CENTRE - JOY_DEADZONE) {
-		// decrement overall index along with selectedRest so they always point to the same restaurant
-		--selectedRest;
+	else if (v < JOY_CENTRE - JOY_DEADZONE && overallIndex > 0) {
 		--overallIndex;
 	}
 
-	// if the selected restaurant has exceeded number of displayed restaurants on screen
-	if (selectedRest > REST_DISP_NUM - 1 && overallIndex < relevantRestaurants) {
-		// reset the screen
-		tft.fillScreen(TFT_BLACK);
-		// reset the selected rest to 0
-		selectedRest = 0;
-		// draw the next 21 restaurants on a new page
-		for (int i = 0; i < REST_DISP_NUM; ++i) {
-			printRestaurant(i + overallIndex);
-		}
-	} else if (selectedRest < 0 && overallIndex >= 0) {
-		// reset the screen
-		tft.fillScreen(TFT_BLACK);
-		// reset the selected rest to 21
-		selectedRest = 20;
-		// draw previous 21 restaurants on new page
-		for (int i = 0; i < REST_DISP_NUM; ++i) {
-			printRestaurant(overallIndex - i);
-		}
+	// Past the bottom or top row, scroll the list by a row to bring the
+	// selected restaurant on screen. Otherwise just move the highlight.
+	if (overallIndex < menuTop || overallIndex >= menuTop + REST_DISP_NUM) {
+		IO_BEGIN(IO_PAGE);
+		int dir = (overallIndex < menuTop) ? -1 : 1;
+		menuTop += dir;
+		restaurant r;
+		waitForList(overallIndex + 1);
+		getRestaurant(&r, restIndex(restaurants[overallIndex]), &card, &cache);
+		menuScroll(&tft, dir, r.name);
 	} else {
-		// constrain the overallIndex variable to number of restaurants
-		overallIndex = constrain(overallIndex, 0, relevantRestaurants);
-
-		// constrain the selected restaurant varaible to number of displayable restaurants
-		selectedRest = constrain(selectedRest, 0, REST_DISP_NUM);
+		menuSelect(&tft, overallIndex - menuTop);
+	}
 
-		// If we picked a new restaurant, update the way it and the previously
-		// selected restaurant are displayed.
-		if (oldRest != selectedRest) {
-			printRestaurant(overallIndexPrev);
-			printRestaurant(overallIndex);
-			delay(50); // so we don't scroll too fast
-		}		
+	if (overallIndex != overallIndexPrev) {
+		lastMenuMove = millis();
 	}
 
 	// If we clicked on a restaurant.
-	if (digitalRead(JOY_SEL) == LOW) {
+	if (joystickTakeClick(&joy)) {
+		IO_BEGIN(IO_SELECT);
 		restaurant r;
-		getRestaurant(&r, restaurants[overallIndex].index, &card, &cache);
-		// Calculate the new map view.
+		waitForList(overallIndex + 1);
+		getRestaurant(&r, restIndex(restaurants[overallIndex]), &card, &cache);
+		showOnMap(r);
+	}
+}
+
+/*
+	Draws the keyboard of the name search across the bottom of the screen,
+	each run of the same key in a row as one key.
 
-		// Center the map view at the restaurant, constraining against the edge of
-		// the map if necessary.
-		curView.mapX = constrain(lon_to_x(r.lon)-DISP_WIDTH/2, 0, MAPWIDTH-DISP_WIDTH);
-		curView.mapY = constrain(lat_to_y(r.lat)-DISP_HEIGHT/2, 0, MAPHEIGHT-DISP_HEIGHT);
+	Arguments:
+		None
 
-		// Draw the cursor, clamping to an edge of the map if needed.
-		curView.cursorX = constrain(lon_to_x(r.lon) - curView.mapX, CURSOR_SIZE/2, DISP_WIDTH-CURSOR_SIZE/2-1);
-		curView.cursorY = constrain(lat_to_y(r.lat) - curView.mapY, CURSOR_SIZE/2, DISP_HEIGHT-CURSOR_SIZE/2-1);
+	Returns:
+		None
+*/
+void drawKeyboard() {
+	tft.setTextColor(TFT_WHITE, TFT_BLACK);
+	for (int row = 0; row < KEY_ROWS; ++row) {
+		int col = 0;
+		while (col < KEY_COLS) {
+			char key = pgm_read_byte(&keys[row][col]);
+			int width = 1;
+			while (col + width < KEY_COLS && pgm_read_byte(&keys[row][col + width]) == key) {
+				++width;
+			}
 
-		preView = curView;
+			const char* label;
+			char c[] = { key, '\0' };
+			if (key == KEY_DELETE) {
+				label = "DEL";
+			} else if (key == KEY_EXIT) {
+				label = "MAP";
+			} else if (key == ' ') {
+				label = "SPACE";
+			} else {
+				label = c;
+			}
 
-		beginMode0();
+			int16_t x = col*KEY_WIDTH, y = KEYBOARD_TOP + row*KEY_HEIGHT;
+			tft.drawRect(x, y, width*KEY_WIDTH, KEY_HEIGHT, TFT_WHITE);
+			// characters are 12 by 16 pixels at size 2
+			tft.setCursor(x + (width*KEY_WIDTH - 12*strlen(label))/2, y + KEY_HEIGHT/2 - 8);
+			tft.print(label);
+			col += width;
+		}
+	}
+}
+
+/*
+	Prints the i'th match of the name search, as its name is held in the name
+	index, highlighted if it is selected.
+
+	Arguments:
+		i (int): index of the match in the list
+
+	Returns:
+		None
+*/
+void printMatch(int i) {
+	NameEntry e;
+	char name[NAME_PREFIX + 1];
 
-		// Ensures a long click of the joystick will not register twice.
-		while (digitalRead(JOY_SEL) == LOW) { delay(10); }
+	if (!getNameEntry(&e, search.first + i, &card, &cache)) {
+		return;
+	}
+	memcpy(name, e.prefix, NAME_PREFIX);
+	name[NAME_PREFIX] = '\0';
+
+	if (i != search.selected) {
+		tft.setTextColor(TFT_WHITE, TFT_BLACK);
 	}
+	else {
+		tft.setTextColor(TFT_BLACK, TFT_WHITE);
+	}
+	tft.setCursor(0, MATCH_TOP + i*15);
+	tft.print(name);
 }
 
 /*
-	Draws buttons on right side of screen which control rating and sort type. 
+	Looks up the name typed so far in the name index, and lists the first
+	SEARCH_ROWS restaurants whose names start with it. Costs two block reads
+	for the lookup and at most two more for the list, so no more than four
+	however many restaurants there are.
 
 	Arguments:
 		None
@@ -514,59 +842,340 @@ void scrollingMenu() {
 	Returns:
 		None
 */
-void buttons() {
-	// draw top button
-	tft.drawRect(DISP_WIDTH, 0, RATING_SIZE, DISP_HEIGHT/2, TFT_WHITE);
-	// draw bottom button
-	tft.drawRect(DISP_WIDTH, DISP_HEIGHT/2, RATING_SIZE, DISP_HEIGHT/2, TFT_WHITE);
-
-	// label top button according to rating
-	if (rating == 1) {
-		tft.drawChar(DISP_WIDTH + (RATING_SIZE/2)-5, DISP_HEIGHT/4 - 8, '1', TFT_WHITE, TFT_BLACK, 2);
-	} else if (rating == 2) {
-		tft.drawChar(DISP_WIDTH + (RATING_SIZE/2)-5, DISP_HEIGHT/4 - 8, '2', TFT_WHITE, TFT_BLACK, 2);
-	} else if (rating == 3) {
-		tft.drawChar(DISP_WIDTH + (RATING_SIZE/2)-5, DISP_HEIGHT/4 - 8, '3', TFT_WHITE, TFT_BLACK, 2);
-	} else if (rating == 4) {
-		tft.drawChar(DISP_WIDTH + (RATING_SIZE/2)-5, DISP_HEIGHT/4 - 8, '4', TFT_WHITE, TFT_BLACK, 2);
-	} else {
-		tft.drawChar(DISP_WIDTH + (RATING_SIZE/2)-5, DISP_HEIGHT/4 - 8, '5', TFT_WHITE, TFT_BLACK, 2);
-	}
-
-	// label bottom button according to sort mode
-	if (sortMode == 1) {
-		tft.drawChar(DISP_WIDTH + (RATING_SIZE/2) - 5, 3*(DISP_HEIGHT/4) - 40, 'I', TFT_WHITE, TFT_BLACK, 2);
-		tft.drawChar(DISP_WIDTH + (RATING_SIZE/2) - 5, 3*(DISP_HEIGHT/4) - 24, 'S', TFT_WHITE, TFT_BLACK, 2);
-		tft.drawChar(DISP_WIDTH + (RATING_SIZE/2) - 5, 3*(DISP_HEIGHT/4) - 8, 'O', TFT_WHITE, TFT_BLACK, 2);
-		tft.drawChar(DISP_WIDTH + (RATING_SIZE/2) - 5, 3*(DISP_HEIGHT/4) + 8, 'R', TFT_WHITE, TFT_BLACK, 2);
-		tft.drawChar(DISP_WIDTH + (RATING_SIZE/2) - 5, 3*(DISP_HEIGHT/4) + 24, 'T', TFT_WHITE, TFT_BLACK, 2);
-	} else if (sortMode == 0) {
-		tft.drawChar(DISP_WIDTH + (RATING_SIZE/2) - 5, 3*(DISP_HEIGHT/4) - 40, 'Q', TFT_WHITE, TFT_BLACK, 2);
-		tft.drawChar(DISP_WIDTH + (RATING_SIZE/2) - 5, 3*(DISP_HEIGHT/4) - 24, 'S', TFT_WHITE, TFT_BLACK, 2);
-		tft.drawChar(DISP_WIDTH + (RATING_SIZE/2) - 5, 3*(DISP_HEIGHT/4) - 8, 'O', TFT_WHITE, TFT_BLACK, 2);
-		tft.drawChar(DISP_WIDTH + (RATING_SIZE/2) - 5, 3*(DISP_HEIGHT/4) + 8, 'R', TFT_WHITE, TFT_BLACK, 2);
-		tft.drawChar(DISP_WIDTH + (RATING_SIZE/2) - 5, 3*(DISP_HEIGHT/4) + 24, 'T', TFT_WHITE, TFT_BLACK, 2);
-	} else {
-		tft.fillRect(DISP_WIDTH + (RATING_SIZE/2) - 5, 3*(DISP_HEIGHT/4) - 40, 10, 80, TFT_BLACK);
-		tft.drawChar(DISP_WIDTH + (RATING_SIZE/2) - 5, 3*(DISP_HEIGHT/4) - 32, 'B', TFT_WHITE, TFT_BLACK, 2);
-		tft.drawChar(DISP_WIDTH + (RATING_SIZE/2) - 5, 3*(DISP_HEIGHT/4) - 16, 'O', TFT_WHITE, TFT_BLACK, 2);
-		tft.drawChar(DISP_WIDTH + (RATING_SIZE/2) - 5, 3*(DISP_HEIGHT/4), 'T', TFT_WHITE, TFT_BLACK, 2);
-		tft.drawChar(DISP_WIDTH + (RATING_SIZE/2) - 5, 3*(DISP_HEIGHT/4) + 16, 'H', TFT_WHITE, TFT_BLACK, 2);
+void updateSearch() {
+	search.first = findName(search.query, &card, &cache);
+	search.count = 0;
+	search.selected = 0;
+
+	NameEntry e;
+	while (search.first != NAME_NO_INDEX && search.count < SEARCH_ROWS
+				 && getNameEntry(&e, search.first + search.count, &card, &cache)
+				 && nameMatches(e, search.query)) {
+		++search.count;
+	}
+
+	tft.fillRect(0, 0, TFT_WIDTH, KEYBOARD_TOP, TFT_BLACK);
+	IO_COUNT(tftBytes, 2L * TFT_WIDTH * KEYBOARD_TOP);
+
+	// the name typed, with a cursor after it
+	tft.setTextColor(TFT_YELLOW, TFT_BLACK);
+	tft.setCursor(0, 0);
+	tft.print(search.query);
+	tft.print('_');
+
+	if (search.first == NAME_NO_INDEX) {
+		tft.setTextColor(TFT_WHITE, TFT_BLACK);
+		tft.setCursor(0, MATCH_TOP);
+		tft.print(F("No name index on card"));
+	}
+	for (int i = 0; i < search.count; ++i) {
+		printMatch(i);
 	}
 }
 
+/*
+	Begin the name search by showing the keyboard with nothing typed yet.
+
+	Arguments:
+		None
+
+	Returns:
+		None
+*/
+void beginSearch() {
+	IO_BEGIN(IO_SEARCH);
+
+	// abandon any part of the map still to be drawn
+	mapJob.row = mapJob.height;
+
+	tft.fillScreen(TFT_BLACK);
+	IO_COUNT(tftBytes, 2L * TFT_WIDTH * TFT_HEIGHT);
+	tft.setTextSize(2);
+	drawKeyboard();
+
+	search.length = 0;
+	search.query[0] = '\0';
+	updateSearch();
+
+	displayMode = SEARCH;
+}
+
+/*
+	Process input during the name search: touching a key types it, the
+	joystick moves through the matches, and clicking it shows the selected
+	match on the map.
+
+	Arguments:
+		None
+
+	Returns:
+		None
+*/
+void typingName() {
+	int16_t dx, dy;
+	joystickTakeMotion(&joy, &dx, &dy);
+
+	int oldMatch = search.selected;
+	if (millis() - lastMenuMove >= MENU_SCROLL_PERIOD) {
+		if (joy.v > JOY_CENTRE + JOY_DEADZONE && search.selected < search.count - 1) {
+			++search.selected;
+		}
+		else if (joy.v < JOY_CENTRE - JOY_DEADZONE && search.selected > 0) {
+			--search.selected;
+		}
+	}
+	if (search.selected != oldMatch) {
+		printMatch(oldMatch);
+		printMatch(search.selected);
+		lastMenuMove = millis();
+	}
+
+	if (joystickTakeClick(&joy) && search.count > 0) {
+		IO_BEGIN(IO_SELECT);
+		NameEntry e;
+		restaurant r;
+		// a failed read leaves the search open rather than jumping nowhere
+		if (getNameEntry(&e, search.first + search.selected, &card, &cache)
+				&& getRestaurant(&r, e.index, &card, &cache)) {
+			showOnMap(r);
+		}
+		return;
+	}
+
+	if (input.touched) {
+		input.touched = false;
+
+		// the touch axes run the opposite way to the display's
+		int x = TFT_WIDTH - 1 - input.touchX;
+		int y = TFT_HEIGHT - 1 - input.touchY;
+		if (y < KEYBOARD_TOP) {
+			return;
+		}
+		// the touch can map past either edge of the display
+		int row = constrain((y - KEYBOARD_TOP) / KEY_HEIGHT, 0, KEY_ROWS - 1);
+		int col = constrain(x / KEY_WIDTH, 0, KEY_COLS - 1);
+		char key = pgm_read_byte(&keys[row][col]);
+
+		if (key == KEY_EXIT) {
+			beginMode0();
+			return;
+		}
+
+		IO_BEGIN(IO_SEARCH);
+		if (key == KEY_DELETE) {
+			if (search.length > 0) {
+				search.query[--search.length] = '\0';
+			}
+		}
+		else if (search.length < NAME_PREFIX) {
+			search.query[search.length++] = key;
+			search.query[search.length] = '\0';
+		}
+		updateSearch();
+	}
+}
+
+/*
+	Samples the joystick and touchscreen. Presses of the joystick button and
+	touches are latched on their leading edge, so holding either one down
+	only registers once and no handler has to wait for it to be released.
+	Runs on a fixed period so joystick motion is integrated evenly.
+
+	Arguments:
+		None
+
+	Returns:
+		None
+*/
+void inputTask() {
+	joystickSample(&joy);
+
+	TSPoint touch = ts.getPoint();
+
+	// Necessary to resume TFT display functions
+	pinMode(YP, OUTPUT);
+	pinMode(XM, OUTPUT);
+
+	bool pressed = (touch.z >= MINPRESSURE && touch.z <= MAXPRESSURE);
+	RECORD_INPUT_SAMPLE(joy.v, joy.h, joy.held,
+											pressed ? touch.x : 0, pressed ? touch.y : 0, pressed ? touch.z : 0);
+
+	if (pressed && millis() - input.lastTouch >= TOUCH_DEBOUNCE) {
+		// map touch points to screen size
+		input.touchX = map(touch.y, TS_MINX, TS_MAXX, 0, TFT_WIDTH);
+		input.touchY = map(touch.x, TS_MINY, TS_MAXY, 0, TFT_HEIGHT);
+		input.touched = true;
+		input.lastTouch = millis();
+	}
+}
+
+/*
+	Processes the sampled input in the current mode.
+
+	Arguments:
+		None
+
+	Returns:
+		None
+*/
+void uiTask() {
+	if (displayMode == MAP) {
+		scrollingMap();
+	}
+	else if (displayMode == MENU) {
+		scrollingMenu();
+	}
+	else {
+		typingName();
+	}
+}
+
+/*
+	Draws the next slice of the map while one is pending, then puts the
+	cursor on top of it once it is complete.
+
+	Arguments:
+		None
+
+	Returns:
+		None
+*/
+void renderTask() {
+	if (displayMode == MAP && lcd_image_job_active(&mapJob)) {
+		if (lcd_image_job_step(&mapJob, &tft, RENDER_BUDGET)) {
+			preView = curView;
+			moveCursor();
+		}
+	}
+}
+
+/*
+	Prints the first page of the menu once it is in its final order, if it
+	has not been printed yet, and keeps it in the list cache.
+
+	Arguments:
+		None
+
+	Returns:
+		true if the page was printed by this call
+*/
+bool showFirstPage() {
+	if (menuShown || !listReady(&build, REST_DISP_NUM)) {
+		return false;
+	}
+	relevantRestaurants = listLength(&build);
+
+	// Show the first page of restaurants.
+	for (int i = 0; i < REST_DISP_NUM && i < relevantRestaurants; ++i) {
+		showRestaurant(i, i);
+	}
+	menuShown = true;
+
+	if (cardErrors.failures == buildFailures) {
+		listCacheStore(&listCache, &build, restaurants);
+	}
+	return true;
+}
+
+/*
+	Builds the sorted list of restaurants a slice at a time while the menu is
+	open, and prints the first page as soon as it is in its final order. A
+	first page from the list cache is printed on its own, and the rest of
+	the list built from the next pass on.
+
+	Arguments:
+		None
+
+	Returns:
+		None
+*/
+void listTask() {
+	if (displayMode != MENU || build.phase == LIST_DONE) {
+		return;
+	}
+
+	if (showFirstPage()) {
+		return;
+	}
+	stepList(&build, restaurants, &card, &cache, LIST_BUDGET);
+	showFirstPage();
+}
+
+/*
+	Draws one of the buttons on the right side of the screen with its label
+	printed down the middle.
+
+	Arguments:
+		button (int): position of the button from the top of the screen
+		label (const char*): text to print on the button
+
+	Returns:
+		None
+*/
+void drawButton(int button, const char* label) {
+	int16_t top = button*BUTTON_HEIGHT;
+	int n = strlen(label);
+
+	tft.fillRect(DISP_WIDTH, top, RATING_SIZE, BUTTON_HEIGHT, TFT_BLACK);
+	IO_COUNT(tftBytes, 2L * RATING_SIZE * BUTTON_HEIGHT);
+	tft.drawRect(DISP_WIDTH, top, RATING_SIZE, BUTTON_HEIGHT, TFT_WHITE);
+
+	// each character is 16 pixels tall at size 2, the last row blank
+	for (int i = 0; i < n; ++i) {
+		tft.drawChar(DISP_WIDTH + (RATING_SIZE/2) - 5, top + (BUTTON_HEIGHT - LABEL_PITCH*n)/2 + LABEL_PITCH*i,
+								 label[i], TFT_WHITE, TFT_BLACK, 2);
+	}
+}
+
+/*
+	Draws buttons on right side of screen which control rating, sort type,
+	distance metric and zoom level, and open the name search. Labels are at
+	most four characters to fit the height of a button.
+
+	Arguments:
+		None
+
+	Returns:
+		None
+*/
+void buttons() {
+	const char* sortLabels[] = { "QSRT", "ISRT", "BOTH" };
+	const char* metricLabels[NUM_METRICS] = { "MANH", "EUCL", "TIME" };
+	// scale of the map at each zoom level, in percent
+	const char* zoomLabels[NUM_ZOOM_LEVELS] = { "100", "50", "25" };
+	char ratingLabel[] = { (char) ('0' + rating), '\0' };
+
+	drawButton(RATING_BUTTON, ratingLabel);
+	drawButton(SORT_BUTTON, sortLabels[sortMode]);
+	drawButton(METRIC_BUTTON, metricLabels[metric]);
+	drawButton(ZOOM_BUTTON, zoomLabels[curView.zoom]);
+	drawButton(FIND_BUTTON, "FIND");
+}
+
+// The tasks run by the main loop, in order of priority.
+Task tasks[] = {
+	{ inputTask, INPUT_PERIOD, 0 },
+	{ uiTask, FRAME_PERIOD, 0 },
+	{ renderTask, 0, 0 },
+	{ listTask, 0, 0 },
+#ifdef TRACE
+	{ traceTask, 0, 0 },
+#endif
+#ifdef SRAM_REPORT
+	{ sramTask, SRAM_CHECK_PERIOD, 0 },
+#endif
+};
+
+// Number of tasks, also used by host/replay which runs the loop itself.
+int numTasks = sizeof(tasks)/sizeof(tasks[0]);
+
 int main() {
 	setup();
 
-	// All the implementation work is done now, just have a loop that processes
-	// the appropriate function!
+	// All the implementation work is done now, just have a loop that runs
+	// the tasks as they are due!
 	while (true) {
-		if (displayMode == MAP) {
-			scrollingMap();
-		}
-		else {
-			scrollingMenu();
-		}
+		runTasks(tasks, numTasks);
 	}
 
 	Serial.end();
@@ -0,0 +1,73 @@
+/*
+	Host stand-in for the Adafruit GFX library: the drawing primitives the
+	firmware uses, built on a drawPixel() provided by the display, and the
+	1 bit canvas to draw into memory. There is no font on the host, so each
+	character is drawn as a pattern of pixels taken from its code instead of
+	its glyph, in the same 6x8 cell.
+*/
+
+#ifndef _HOST_ADAFRUIT_GFX_H_
+#define _HOST_ADAFRUIT_GFX_H_
+
+#include <Arduino.h>
+
+class Adafruit_GFX {
+public:
+  Adafruit_GFX(int16_t w, int16_t h);
+  virtual ~Adafruit_GFX() {}
+
+  virtual void drawPixel(int16_t x, int16_t y, uint16_t color) = 0;
+  virtual void fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color);
+  virtual void fillScreen(uint16_t color);
+  virtual void setRotation(uint8_t r);
+
+  void drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color);
+  void drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color);
+  void drawRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color);
+  void drawCircle(int16_t x0, int16_t y0, int16_t r, uint16_t color);
+  void fillCircle(int16_t x0, int16_t y0, int16_t r, uint16_t color);
+  void drawChar(int16_t x, int16_t y, unsigned char c, uint16_t color, uint16_t bg, uint8_t size);
+
+  void setCursor(int16_t x, int16_t y) { cursor_x = x; cursor_y = y; }
+  void setTextColor(uint16_t c) { textcolor = textbgcolor = c; }
+  void setTextColor(uint16_t c, uint16_t bg) { textcolor = c; textbgcolor = bg; }
+  void setTextSize(uint8_t s) { textsize = s > 0 ? s : 1; }
+  void setTextWrap(bool w) { wrap = w; }
+  int16_t width() const { return _width; }
+  int16_t height() const { return _height; }
+
+  size_t write(uint8_t c);
+  void print(const char* s);
+  void print(char c);
+  void print(int n);
+  void print(unsigned int n);
+  void print(long n);
+  void print(unsigned long n);
+  template <class T> void println(T x) { print(x); write('\n'); }
+
+protected:
+  const int16_t WIDTH, HEIGHT; // size of the display without rotation
+  int16_t _width, _height;     // size of the display as rotated
+  uint8_t rotation;
+  int16_t cursor_x, cursor_y;
+  uint16_t textcolor, textbgcolor;
+  uint8_t textsize;
+  bool wrap;
+};
+
+// An image of 1 bit pixels in memory, each row a whole number of bytes with
+// the leftmost pixel in the high bit, as in the library.
+class GFXcanvas1 : public Adafruit_GFX {
+public:
+  GFXcanvas1(uint16_t w, uint16_t h);
+  ~GFXcanvas1();
+
+  void drawPixel(int16_t x, int16_t y, uint16_t color);
+  void fillScreen(uint16_t color);
+  uint8_t* getBuffer() const { return buffer; }
+
+private:
+  uint8_t* buffer;
+};
+
+#endif
@@ -0,0 +1,127 @@
+/*
+	Host stand-in for the parts of the Arduino core used by the firmware, so
+	the firmware modules can be compiled and run on Linux by the host tools.
+*/
+
+#ifndef _HOST_ARDUINO_H_
+#define _HOST_ARDUINO_H_
+
+#include <ctype.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <type_traits>
+
+// clock of the Mega, which the timing of the peripherals is given in
+#define F_CPU 16000000L
+
+// pins used by the firmware
+#define A2 56
+#define A3 57
+#define A8 62
+#define A9 63
+
+#define LOW  0
+#define HIGH 1
+#define INPUT        0
+#define OUTPUT       1
+#define INPUT_PULLUP 2
+
+#define DEC 10
+#define HEX 16
+
+// there is no separate program memory on the host
+#define PROGMEM
+#define pgm_read_byte(p)  (*(const uint8_t*) (p))
+#define pgm_read_word(p)  (*(const uint16_t*) (p))
+#define pgm_read_dword(p) (*(const uint32_t*) (p))
+#define F(s) (s)
+
+typedef uint8_t byte;
+
+// min/max/constrain are macros on the Arduino, but macros would clash with
+// the standard library on the host.
+template <class A, class B> inline typename std::common_type<A, B>::type min(A a, B b) {
+  return a < b ? a : b;
+}
+template <class A, class B> inline typename std::common_type<A, B>::type max(A a, B b) {
+  return a > b ? a : b;
+}
+template <class T, class L, class H> inline T constrain(T x, L lo, H hi) {
+  return x < lo ? lo : (x > hi ? hi : x);
+}
+
+long map(long x, long in_min, long in_max, long out_min, long out_max);
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+void init();
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+int analogRead(uint8_t pin);
+
+// Host only: the levels read from the pins, which a host tool sets to the
+// input it wants the firmware to see. Analog pins rest at 512 and digital
+// pins high.
+#define HOST_NUM_PINS 70
+extern int hostAnalog[HOST_NUM_PINS];
+extern uint8_t hostDigital[HOST_NUM_PINS];
+
+// Host only: run millis() and micros() from a simulated clock instead of
+// the real one. The simulated clock only moves when the stand-ins for the
+// hardware charge it the time they would take on the Mega, and by
+// HOST_CLOCK_READ_NS on every read of the clock, so a run takes the same
+// simulated time on every machine. The hook, if any, is called on every
+// read of the clock, for tools to charge the time of other work.
+#define HOST_CLOCK_READ_NS 1000
+void hostUseSimulatedClock(void (*hook)() = NULL);
+void hostCharge(uint32_t nanos);
+uint64_t hostNanos();
+
+// Host only: charge the time of what follows to a lane of its own rather
+// than to the clock, until hostLaneEnd() returns the time charged to it,
+// for work the Mega does at the same time as other work. Lanes do not nest.
+void hostLaneBegin();
+uint64_t hostLaneEnd();
+
+// Serial port, written to a stdio stream (stdout unless redirected).
+class HardwareSerial {
+public:
+  HardwareSerial();
+  void begin(long baud);
+  void end();
+  void flush();
+
+  size_t write(uint8_t c);
+  size_t write(const uint8_t* buf, size_t n);
+  int availableForWrite();
+  int available();
+  int read();
+
+  void print(const char* s);
+  void print(char c);
+  void print(unsigned char n, int base = DEC);
+  void print(int n, int base = DEC);
+  void print(unsigned int n, int base = DEC);
+  void print(long n, int base = DEC);
+  void print(unsigned long n, int base = DEC);
+
+  void println();
+  template <class T> void println(T x) { print(x); println(); }
+  template <class T> void println(T x, int base) { print(x, base); println(); }
+
+  // Host only: where output goes, NULL to discard it.
+  void setOutput(FILE* out);
+
+private:
+  FILE* out;
+};
+
+extern HardwareSerial Serial;
+
+#endif
@@ -0,0 +1,63 @@
+/*
+	Host stand-in for the MCUFRIEND_kbv display driver: a 320x480 frame
+	buffer. Pixels can be set one at a time or streamed into an address
+	window, and every pixel written is counted and charged to the simulated
+	clock at the rate of the parallel display on the Mega.
+*/
+
+#ifndef _HOST_MCUFRIEND_KBV_H_
+#define _HOST_MCUFRIEND_KBV_H_
+
+#include "Adafruit_GFX.h"
+
+#define TFT_BLACK   0x0000
+#define TFT_NAVY    0x000F
+#define TFT_BLUE    0x001F
+#define TFT_GREEN   0x07E0
+#define TFT_CYAN    0x07FF
+#define TFT_RED     0xF800
+#define TFT_MAGENTA 0xF81F
+#define TFT_YELLOW  0xFFE0
+#define TFT_WHITE   0xFFFF
+
+// Simulated time to write one pixel, in nanoseconds: streamed through an
+// address window, and set alone (which first sets a window of one pixel).
+// Setting the window takes the difference, and is charged for every fill
+// and every window set.
+#define TFT_PUSH_NS   500
+#define TFT_PIXEL_NS  4000
+#define TFT_WINDOW_NS (TFT_PIXEL_NS - TFT_PUSH_NS)
+
+class MCUFRIEND_kbv : public Adafruit_GFX {
+public:
+  MCUFRIEND_kbv();
+
+  uint16_t readID() { return 0x9486; }
+  void begin(uint16_t id) {}
+  void startWrite() {}
+  void endWrite() {}
+
+  void drawPixel(int16_t x, int16_t y, uint16_t color);
+  void fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color);
+  void fillScreen(uint16_t color);
+  void setRotation(uint8_t r);
+
+  void setAddrWindow(int16_t x0, int16_t y0, int16_t x1, int16_t y1);
+  void pushColors(uint16_t* block, int16_t n, bool first);
+  void writePixel(int16_t x, int16_t y, uint16_t color) { drawPixel(x, y, color); }
+
+  // Host only: the display as rotated, row by row, in RGB565.
+  const uint16_t* frame() const { return fb; }
+
+  // Host only: number of pixels written to the display.
+  uint32_t pixelsWritten;
+
+private:
+  void put(int16_t x, int16_t y, uint16_t color);
+
+  uint16_t fb[320 * 480];
+  int16_t winX0, winY0, winX1, winY1; // address window
+  int16_t winX, winY;                 // next pixel of the window
+};
+
+#endif
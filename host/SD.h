@@ -0,0 +1,146 @@
+/*
+	Host stand-in for the Arduino SD library. Raw block reads come from a
+	card image: a file holding consecutive 512 byte blocks of the card,
+	starting at a given block (normally REST_START_BLOCK). Files opened
+	through the FAT file system come from a directory on the host standing
+	in for the root of the card. The image and the files are mapped into
+	memory, and a block is copied only into the buffer the firmware reads it
+	into, or not at all by mapBlock() and mapData().
+
+	Reads, seeks and opens are charged to the simulated clock (see Arduino.h)
+	at roughly the time they take through the SD library at half speed.
+	Reads are charged for each command and each block sent, so streaming a
+	run of blocks with one multi-block read costs less than reading them one
+	at a time, and the commands are counted. Like the SD library, a file
+	keeps the last block it read, and reads a whole block with one command
+	for any byte not in it.
+
+	The files can also be read as raw blocks, as if each were in consecutive
+	blocks of its own starting from HOST_FILE_BLOCK (see ../sdstream.h).
+
+	Raw transfers take time in proportion to the SPI clock the card is set
+	to, and the card can be made unreliable (setFaults) to exercise the
+	clock negotiation and the retries of ../sdcard.h.
+*/
+
+#ifndef _HOST_SD_H_
+#define _HOST_SD_H_
+
+#include <Arduino.h>
+
+#define SPI_FULL_SPEED    0
+#define SPI_HALF_SPEED    1
+#define SPI_QUARTER_SPEED 2
+
+#define FILE_READ 0
+
+// first of the blocks the files of the card are read from as raw blocks
+#define HOST_FILE_BLOCK 1000
+
+// simulated time of the card operations, in nanoseconds: a command and
+// the wait for the card to respond, sending a block of data at
+// SPI_HALF_SPEED, and stopping a multi-block read
+#define SD_COMMAND_NS    250000
+#define SD_TRANSFER_NS   950000
+#define SD_STOP_NS        50000
+#define SD_OPEN_NS      4000000
+#define SD_SEEK_NS       150000
+
+class Sd2Card {
+public:
+  Sd2Card();
+  ~Sd2Card();
+
+  uint8_t init(uint8_t sckRateID = SPI_FULL_SPEED, uint8_t chipSelectPin = 10);
+  uint8_t setSckRate(uint8_t sckRateID);
+  uint8_t readBlock(uint32_t block, uint8_t* dst);
+
+  // Host only: multi-block reads, with the names SdFat gives them.
+  bool readStart(uint32_t block);
+  bool readData(uint8_t* dst);
+  bool readStop();
+
+  // Host only: reads that leave the block where it is in the mapped image
+  // rather than copying it out, returning NULL if the read fails. They are
+  // counted and charged as readBlock() and readData() are. A block of
+  // mapBlock() stays there until the card is closed: one that is not in
+  // the image as it is (corrupted by setFaults(), or the padded end of a
+  // file) is copied to dst, which is returned. A block of mapData() stays
+  // only until the next read.
+  const uint8_t* mapBlock(uint32_t block, uint8_t* dst);
+  const uint8_t* mapData();
+
+  // Host only: use the card image in the named file, or in memory.
+  bool open(const char* path, uint32_t firstBlock);
+  void openMemory(const uint8_t* data, uint32_t numBlocks, uint32_t firstBlock);
+
+  // Host only: the raw blocks of a file of the card (see SDClass::setRoot).
+  bool locate(const char* name, uint32_t* first, uint32_t* count);
+
+  // Host only: make the card unreliable. Reads at a clock faster than
+  // fastestGood fail or come back with a byte wrong in turn, and every
+  // failEvery'th read at any clock fails (never if 0).
+  void setFaults(uint8_t fastestGood, uint32_t failEvery);
+
+  // Host only: number of blocks read from the card, and of commands sent.
+  uint32_t blockReads;
+  uint32_t commands;
+
+private:
+  const uint8_t* blockAt(uint32_t block);
+  const uint8_t* transfer(uint32_t block);
+
+  uint8_t rate;                   // sckRateID of the clock
+  uint8_t fastestGood;
+  uint32_t failEvery, transfers;
+
+  const uint8_t* mem;
+  size_t mapped;       // bytes of the image mapped by open(), 0 if in memory
+  uint32_t firstBlock, numBlocks;
+  uint32_t streamNext; // next block of the multi-block read
+  uint8_t scratch[512]; // a block read with a byte wrong, or the padded end of a file
+};
+
+class File {
+public:
+  File() : data(NULL), length(0), pos(0), cached(NO_BLOCK) {}
+  File(const uint8_t* data, uint32_t length) : data(data), length(length), pos(0), cached(NO_BLOCK) {}
+
+  int read(void* buf, uint16_t n);
+  bool seek(uint32_t pos);
+  uint32_t position();
+  uint32_t size();
+  int available();
+  void close();
+  operator bool() const { return data != NULL; }
+  bool operator==(const void* p) const { return (data != NULL) == (p != NULL); }
+
+private:
+  static const uint32_t NO_BLOCK = 0xFFFFFFFF;
+
+  const uint8_t* data; // the file, mapped into memory
+  uint32_t length, pos;
+  uint32_t cached; // block of the file last read
+};
+
+class SDClass {
+public:
+  SDClass() : commands(0), root(".") {}
+
+  bool begin(uint8_t chipSelectPin = 10);
+  File open(const char* path, uint8_t mode = FILE_READ);
+
+  // Host only: the directory holding the files of the card.
+  void setRoot(const char* dir) { root = dir; }
+  const char* getRoot() const { return root; }
+
+  // Host only: number of commands sent reading files.
+  uint32_t commands;
+
+private:
+  const char* root;
+};
+
+extern SDClass SD;
+
+#endif
@@ -0,0 +1,9 @@
+/*
+	Host stand-in for the Arduino SPI library, which the firmware only
+	includes.
+*/
+
+#ifndef _HOST_SPI_H_
+#define _HOST_SPI_H_
+
+#endif
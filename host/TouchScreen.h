@@ -0,0 +1,30 @@
+/*
+	Host stand-in for the Adafruit TouchScreen library. The plate is not
+	read: getPoint() returns hostTouch, which a host tool sets to the touch
+	it wants the firmware to see.
+*/
+
+#ifndef _HOST_TOUCHSCREEN_H_
+#define _HOST_TOUCHSCREEN_H_
+
+#include <Arduino.h>
+
+class TSPoint {
+public:
+  TSPoint() : x(0), y(0), z(0) {}
+  TSPoint(int16_t x, int16_t y, int16_t z) : x(x), y(y), z(z) {}
+
+  int16_t x, y, z;
+};
+
+class TouchScreen {
+public:
+  TouchScreen(uint8_t xp, uint8_t yp, uint8_t xm, uint8_t ym, uint16_t rxplate) {}
+
+  TSPoint getPoint();
+};
+
+// Host only: the raw reading of the plate, z 0 when it is not pressed.
+extern TSPoint hostTouch;
+
+#endif
@@ -0,0 +1,315 @@
+/*
+	Builds the contents of the SD card from source data: the card image
+	(the restaurants in rank order, the name index, the near table and the
+	marker table, see cardimage.h) and the map pyramid the firmware draws
+	(yeg-big.lcd, yeg-mid.lcd and yeg-sml.lcd, each level the one above
+	halved).
+
+	Usage:
+		cardbuild [--threads N] RESTAURANTS MAP OUTDIR
+
+	RESTAURANTS is a CSV file with a line "lat,lon,rating,name" for each of
+	the NUM_RESTAURANTS restaurants the firmware is built for: latitude and
+	longitude in degrees, the rating from 0 to 10, and the name, which may
+	be quoted and is cut to 54 characters. A first line that is not a
+	restaurant is taken as a header, and lines starting with '#' are
+	skipped. MAP is a binary PPM of the full size map, MAPWIDTH by MAPHEIGHT
+	pixels, or of a smaller map, a whole fraction of that size, which is
+	scaled up to it (as for the synthetic map of `make check`). OUTDIR,
+	made if it does not exist, gets card.img, to be written to the card
+	from block REST_START_BLOCK, and the .lcd files, to be copied onto it.
+
+	The near table is built a cell at a time and the map a tile of
+	NEAR_CELL pixels at a time, shared out over a thread per core (or
+	--threads N) with work stealing. Each task writes only its own part of
+	the output, so the output is the same for any number of threads. The
+	time of each stage is printed at the end.
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include <errno.h>
+#include <sys/stat.h>
+
+#include "cardimage.h"
+
+// The files of the map pyramid, by zoom level, as a2part2.cpp opens them.
+static const char* const mapFiles[NUM_ZOOM_LEVELS] = { "yeg-big.lcd", "yeg-mid.lcd", "yeg-sml.lcd" };
+
+// A stage of the build and how long it took.
+struct Stage {
+  std::string name;
+  double ms;
+};
+
+static std::vector<Stage> stages;
+static std::chrono::steady_clock::time_point stageStart;
+
+// Ends the stage under way, naming it, and starts the next.
+static void endStage(const char* name) {
+  auto now = std::chrono::steady_clock::now();
+  stages.push_back({ name, std::chrono::duration<double, std::milli>(now - stageStart).count() });
+  stageStart = now;
+}
+
+// Degrees as the card holds them, in hundred thousandths.
+static int32_t cardDegrees(double degrees) {
+  return (int32_t) llround(degrees * 100000);
+}
+
+// Parses one line of the restaurants file into r, returning false if it is
+// not a restaurant.
+static bool parseRestaurant(const std::string& line, restaurant* r) {
+  double lat, lon;
+  int rating, used;
+  if (sscanf(line.c_str(), " %lf , %lf , %d ,%n", &lat, &lon, &rating, &used) != 3 || rating < 0 || rating > 10) {
+    return false;
+  }
+
+  std::string name = line.substr(used);
+  while (!name.empty() && (name.back() == '\r' || name.back() == '\n')) {
+    name.pop_back();
+  }
+  if (name.size() >= 2 && name.front() == '"' && name.back() == '"') {
+    std::string quoted = name.substr(1, name.size() - 2);
+    name.clear();
+    for (size_t i = 0; i < quoted.size(); i++) {
+      name += quoted[i];
+      if (quoted[i] == '"' && i + 1 < quoted.size() && quoted[i + 1] == '"') {
+        i++;
+      }
+    }
+  }
+
+  memset(r, 0, sizeof(*r));
+  r->lat = cardDegrees(lat);
+  r->lon = cardDegrees(lon);
+  r->rating = rating;
+  strncpy(r->name, name.c_str(), sizeof(r->name) - 1);
+  return true;
+}
+
+static bool readRestaurants(const char* path, std::vector<restaurant>& recs) {
+  FILE* f = fopen(path, "r");
+  if (f == NULL) {
+    fprintf(stderr, "cannot read %s\n", path);
+    return false;
+  }
+  char buf[512];
+  int lineNo = 0;
+  bool ok = true, first = true;
+  while (ok && fgets(buf, sizeof(buf), f)) {
+    lineNo++;
+    std::string line(buf);
+    if (line[0] == '#' || line.find_first_not_of(" \t\r\n") == std::string::npos) {
+      continue;
+    }
+    restaurant r;
+    if (parseRestaurant(line, &r)) {
+      recs.push_back(r);
+    } else if (!first) {
+      fprintf(stderr, "%s:%d: not \"lat,lon,rating,name\"\n", path, lineNo);
+      ok = false;
+    }
+    first = false;
+  }
+  fclose(f);
+
+  if (ok && recs.size() != NUM_RESTAURANTS) {
+    fprintf(stderr, "%s has %zu restaurants, the firmware is built for %d\n", path, recs.size(), NUM_RESTAURANTS);
+    ok = false;
+  }
+  return ok;
+}
+
+static bool readPPM(const char* path, std::vector<uint8_t>& rgb, int& w, int& h) {
+  FILE* f = fopen(path, "rb");
+  int maxval;
+  if (f == NULL) {
+    return false;
+  }
+  if (fscanf(f, "P6 %d %d %d", &w, &h, &maxval) != 3 || maxval != 255 || fgetc(f) == EOF) {
+    fclose(f);
+    return false;
+  }
+  rgb.resize((size_t) w * h * 3);
+  bool ok = fread(rgb.data(), 1, rgb.size(), f) == rgb.size();
+  fclose(f);
+  return ok;
+}
+
+// Runs task(x0, y0) for each tile of NEAR_CELL pixels of a level of the map
+// size pixels square, over the pool.
+static void forEachTile(WorkPool* pool, int size, const std::function<void(int, int)>& task) {
+  int tiles = std::max(size / NEAR_CELL, 1);
+  pool->run(tiles * tiles, [&](size_t t) {
+    task((t % tiles) * NEAR_CELL, (t / tiles) * NEAR_CELL);
+  });
+}
+
+// A level of the map: RGB triples, size pixels square.
+struct Level {
+  int size;
+  std::vector<uint8_t> rgb;
+};
+
+// The full size level from a map factor times smaller, each pixel
+// repeated factor times each way.
+static Level scaleUp(const Level& small, int factor, WorkPool* pool) {
+  Level full;
+  full.size = small.size * factor;
+  full.rgb.resize((size_t) full.size * full.size * 3);
+  forEachTile(pool, full.size, [&](int x0, int y0) {
+    for (int y = y0; y < std::min(y0 + NEAR_CELL, full.size); y++) {
+      for (int x = x0; x < std::min(x0 + NEAR_CELL, full.size); x++) {
+        memcpy(&full.rgb[((size_t) y * full.size + x) * 3],
+               &small.rgb[((size_t) (y / factor) * small.size + x / factor) * 3], 3);
+      }
+    }
+  });
+  return full;
+}
+
+// The level below: each pixel the mean of the four above it, rounded.
+static Level halve(const Level& above, WorkPool* pool) {
+  Level below;
+  below.size = above.size / 2;
+  below.rgb.resize((size_t) below.size * below.size * 3);
+  forEachTile(pool, below.size, [&](int x0, int y0) {
+    for (int y = y0; y < std::min(y0 + NEAR_CELL, below.size); y++) {
+      for (int x = x0; x < std::min(x0 + NEAR_CELL, below.size); x++) {
+        for (int c = 0; c < 3; c++) {
+          const uint8_t* p = &above.rgb[((size_t) 2 * y * above.size + 2 * x) * 3 + c];
+          size_t row = (size_t) above.size * 3;
+          below.rgb[((size_t) y * below.size + x) * 3 + c] = (p[0] + p[3] + p[row] + p[row + 3] + 2) / 4;
+        }
+      }
+    }
+  });
+  return below;
+}
+
+// The level as an .lcd file: RGB565 pixels, high byte first, row by row.
+static std::vector<uint8_t> lcdFile(const Level& level, WorkPool* pool) {
+  std::vector<uint8_t> lcd((size_t) level.size * level.size * 2);
+  forEachTile(pool, level.size, [&](int x0, int y0) {
+    for (int y = y0; y < std::min(y0 + NEAR_CELL, level.size); y++) {
+      for (int x = x0; x < std::min(x0 + NEAR_CELL, level.size); x++) {
+        size_t i = (size_t) y * level.size + x;
+        const uint8_t* p = &level.rgb[i * 3];
+        uint16_t pixel = ((p[0] >> 3) << 11) | ((p[1] >> 2) << 5) | (p[2] >> 3);
+        lcd[i * 2] = pixel >> 8;
+        lcd[i * 2 + 1] = pixel & 0xFF;
+      }
+    }
+  });
+  return lcd;
+}
+
+// Makes the directory and any of its parents that do not exist.
+static bool makeDirs(const std::string& path) {
+  for (size_t i = 1; i <= path.size(); i++) {
+    if (i == path.size() || path[i] == '/') {
+      std::string dir = path.substr(0, i);
+      if (mkdir(dir.c_str(), 0777) != 0 && errno != EEXIST) {
+        fprintf(stderr, "cannot make %s: %s\n", dir.c_str(), strerror(errno));
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+static bool writeFile(const std::string& path, const std::vector<uint8_t>& data) {
+  if (!writeImage(path.c_str(), data)) {
+    fprintf(stderr, "cannot write %s\n", path.c_str());
+    return false;
+  }
+  return true;
+}
+
+int main(int argc, char** argv) {
+  int threads = 0;
+  int arg = 1;
+  if (argc > 2 && std::string(argv[1]) == "--threads") {
+    threads = atoi(argv[2]);
+    arg = 3;
+  }
+  if (argc - arg != 3) {
+    fprintf(stderr, "usage: %s [--threads N] RESTAURANTS MAP OUTDIR\n", argv[0]);
+    return 2;
+  }
+  const char* restPath = argv[arg];
+  const char* mapPath = argv[arg + 1];
+  std::string out = std::string(argv[arg + 2]) + "/";
+  if (!makeDirs(argv[arg + 2])) {
+    return 2;
+  }
+
+  WorkPool pool(threads);
+  auto start = std::chrono::steady_clock::now();
+  stageStart = start;
+
+  std::vector<restaurant> recs;
+  if (!readRestaurants(restPath, recs)) {
+    return 2;
+  }
+  endStage("read restaurants");
+
+  std::stable_sort(recs.begin(), recs.end(), ranked);
+  std::vector<uint8_t> image((const uint8_t*) recs.data(), (const uint8_t*) (recs.data() + recs.size()));
+  endStage("rank");
+
+  placeImage(image, NAME_INDEX_OFFSET, buildNameIndex(recs.data()));
+  endStage("name index");
+
+  NearStats stats;
+  placeImage(image, NEAR_TABLE_OFFSET, buildNearTable(recs.data(), &pool, &stats));
+  endStage("near table");
+
+  placeImage(image, MARKER_TABLE_OFFSET, buildMarkerTable(recs.data()));
+  endStage("marker table");
+
+  if (!writeFile(out + "card.img", image)) {
+    return 2;
+  }
+  endStage("write card.img");
+
+  Level level;
+  int h;
+  if (!readPPM(mapPath, level.rgb, level.size, h) || level.size != h || level.size <= 0 ||
+      MAPWIDTH % level.size != 0 || MAPWIDTH != MAPHEIGHT) {
+    fprintf(stderr, "%s is not a %dx%d binary PPM, or a whole fraction of that size\n",
+            mapPath, MAPWIDTH, MAPHEIGHT);
+    return 2;
+  }
+  if (level.size != MAPWIDTH) {
+    level = scaleUp(level, MAPWIDTH / level.size, &pool);
+  }
+  endStage("read map");
+
+  for (uint8_t zoom = 0; zoom < NUM_ZOOM_LEVELS; zoom++) {
+    if (zoom > 0) {
+      level = halve(level, &pool);
+    }
+    std::vector<uint8_t> lcd = lcdFile(level, &pool);
+    if (!writeFile(out + mapFiles[zoom], lcd)) {
+      return 2;
+    }
+    endStage(mapFiles[zoom]);
+  }
+
+  printf("%d restaurants, %zu near sets of %.1f on average (largest %zu, %zu too large for a slot)\n",
+         NUM_RESTAURANTS, stats.sets, (double) stats.entries / stats.sets, stats.largest, stats.overflows);
+  printf("%d threads, %zu tasks stolen\n", pool.threads(), pool.steals());
+  for (const Stage& s : stages) {
+    printf("%-18s %9.1f ms\n", s.name.c_str(), s.ms);
+  }
+  printf("%-18s %9.1f ms\n", "total",
+         std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+  return 0;
+}
@@ -0,0 +1,251 @@
+#include "cardimage.h"
+
+#include <algorithm>
+#include <strings.h>
+
+bool readImage(const char* path, std::vector<uint8_t>& image) {
+  FILE* f = fopen(path, "rb");
+  if (f == NULL) {
+    return false;
+  }
+  uint8_t buf[4096];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), f)) > 0) {
+    image.insert(image.end(), buf, buf + n);
+  }
+  fclose(f);
+  return image.size() >= RESTAURANT_BYTES;
+}
+
+bool writeImage(const char* path, const std::vector<uint8_t>& image) {
+  FILE* f = fopen(path, "wb");
+  if (f == NULL) {
+    return false;
+  }
+  bool ok = fwrite(image.data(), 1, image.size(), f) == image.size();
+  return fclose(f) == 0 && ok;
+}
+
+void placeImage(std::vector<uint8_t>& image, size_t offset, const std::vector<uint8_t>& part) {
+  if (image.size() < offset + part.size()) {
+    image.resize(offset + part.size(), 0);
+  }
+  std::copy(part.begin(), part.end(), image.begin() + offset);
+}
+
+bool imageHolds(const std::vector<uint8_t>& image, size_t offset, const std::vector<uint8_t>& part) {
+  return image.size() >= offset + part.size() && std::equal(part.begin(), part.end(), image.begin() + offset);
+}
+
+bool ranked(const restaurant& a, const restaurant& b) {
+  if (a.rating != b.rating) {
+    return a.rating > b.rating;
+  }
+  int byName = strncasecmp(a.name, b.name, sizeof(a.name));
+  return byName != 0 ? byName < 0 : strncmp(a.name, b.name, sizeof(a.name)) < 0;
+}
+
+static NameEntry entryOf(const restaurant& r, uint16_t index) {
+  NameEntry e;
+  memset(&e, 0, sizeof(e));
+  for (int i = 0; i < NAME_PREFIX && i < (int) sizeof(r.name) && r.name[i] != '\0'; i++) {
+    e.prefix[i] = nameFold(r.name[i]);
+  }
+  e.index = index;
+  return e;
+}
+
+static bool before(const NameEntry& a, const NameEntry& b) {
+  int byName = memcmp(a.prefix, b.prefix, NAME_PREFIX);
+  return byName != 0 ? byName < 0 : a.index < b.index;
+}
+
+// The first block, then the blocks of entries.
+std::vector<uint8_t> buildNameIndex(const restaurant* recs) {
+  std::vector<NameEntry> entries;
+  for (int i = 0; i < NUM_RESTAURANTS; i++) {
+    entries.push_back(entryOf(recs[i], i));
+  }
+  std::sort(entries.begin(), entries.end(), before);
+
+  std::vector<uint8_t> index(NAME_INDEX_BYTES, 0);
+  NameIndexHeader* header = (NameIndexHeader*) index.data();
+  header->magic = NAME_INDEX_MAGIC;
+  header->count = entries.size();
+  header->leaves = NAME_LEAVES;
+
+  NameEntry* leaves = (NameEntry*) (index.data() + 512);
+  for (size_t k = 0; k < (size_t) NAME_LEAVES * NAME_LEAF_ENTRIES; k++) {
+    if (k < entries.size()) {
+      leaves[k] = entries[k];
+    } else {
+      memset(leaves[k].prefix, 0, NAME_PREFIX);
+      leaves[k].index = NAME_UNUSED;
+    }
+    if (k % NAME_LEAF_ENTRIES == 0) {
+      memcpy(header->fence[k / NAME_LEAF_ENTRIES], leaves[k].prefix, NAME_PREFIX);
+    }
+  }
+  return index;
+}
+
+/*
+	A restaurant is in the near set of a cell if, at some zoom level and by
+	some metric of the table, it is no farther from the nearest point of the
+	cell than the REST_PAGE_SIZE'th restaurant is from the farthest. Any
+	other restaurant has REST_PAGE_SIZE restaurants closer to it from every
+	point of the cell. The points of a cell at zoom level z are the cursor
+	positions the firmware maps into it, and the distances are the firmware
+	metrics on the pixels of that level, so rounding is the same as in the
+	list build.
+*/
+
+// Longest distance a list key holds on the Mega, where keys are shortest.
+// Distances are compared as the keys hold them, so the sets hold for every
+// build.
+#define KEY_DIST_MAX ((1U << (24 - 11)) - 1)
+
+static const int nearMetrics[] = { MANHATTAN, EUCLIDEAN };
+
+// Distance by the metric between points dx and dy apart, as a key holds it.
+static uint16_t keyDist(int metric, int32_t dx, int32_t dy, uint8_t zoom) {
+  return std::min<uint32_t>(distance(metric, 0, 0, dx, dy, zoom), KEY_DIST_MAX);
+}
+
+// Nearest and farthest any point of [lo, hi] is from p along one axis.
+static void span(int32_t p, int32_t lo, int32_t hi, int32_t* nearest, int32_t* farthest) {
+  *nearest = p < lo ? lo - p : (p > hi ? p - hi : 0);
+  *farthest = std::max(std::abs(p - lo), std::abs(p - hi));
+}
+
+// Adds the restaurants of the set of the cell at (cx, cy) at one zoom level
+// and metric to inSet.
+static void addCandidates(const restaurant* recs, const std::vector<int>& rated, int cx, int cy,
+                          uint8_t zoom, int metric, std::vector<bool>& inSet) {
+  if (rated.size() <= REST_PAGE_SIZE) {
+    for (int i : rated) {
+      inSet[i] = true;
+    }
+    return;
+  }
+
+  int32_t x0 = (cx << NEAR_SHIFT) >> zoom, x1 = (((cx + 1) << NEAR_SHIFT) >> zoom) - 1;
+  int32_t y0 = (cy << NEAR_SHIFT) >> zoom, y1 = (((cy + 1) << NEAR_SHIFT) >> zoom) - 1;
+
+  std::vector<uint16_t> nearest(rated.size()), farthest(rated.size());
+  for (size_t k = 0; k < rated.size(); k++) {
+    const restaurant& r = recs[rated[k]];
+    int32_t nx, fx, ny, fy;
+    span(lon_to_x(r.lon, zoom), x0, x1, &nx, &fx);
+    span(lat_to_y(r.lat, zoom), y0, y1, &ny, &fy);
+    nearest[k] = keyDist(metric, nx, ny, zoom);
+    farthest[k] = keyDist(metric, fx, fy, zoom);
+  }
+
+  std::nth_element(farthest.begin(), farthest.begin() + REST_PAGE_SIZE - 1, farthest.end());
+  uint16_t limit = farthest[REST_PAGE_SIZE - 1];
+  for (size_t k = 0; k < rated.size(); k++) {
+    if (nearest[k] <= limit) {
+      inSet[rated[k]] = true;
+    }
+  }
+}
+
+// Writes the slot of the cell at (cx, cy) for a rating into the table, and
+// returns the size of its set.
+static size_t buildSlot(const restaurant* recs, const std::vector<int>& rated, int cx, int cy, int rating,
+                        uint8_t* table) {
+  std::vector<bool> inSet(NUM_RESTAURANTS, false);
+  for (uint8_t zoom = 0; zoom < NUM_ZOOM_LEVELS; zoom++) {
+    for (int metric : nearMetrics) {
+      addCandidates(recs, rated, cx, cy, zoom, metric, inSet);
+    }
+  }
+
+  std::vector<int> set;
+  for (int i = 0; i < NUM_RESTAURANTS; i++) {
+    if (inSet[i]) {
+      set.push_back(i);
+    }
+  }
+
+  uint16_t count = set.size() > NEAR_SLOT_ENTRIES ? NEAR_OVERFLOW : set.size();
+  NearBlock* blocks = (NearBlock*) (table + (size_t) nearSlot(cx, cy, rating) * NEAR_SLOT_BLOCKS * 512);
+  for (int k = 0; k < NEAR_SLOT_BLOCKS; k++) {
+    blocks[k].magic = NEAR_TABLE_MAGIC;
+    blocks[k].count = count;
+    blocks[k].total = rated.size();
+  }
+  for (size_t j = 0; count != NEAR_OVERFLOW && j < set.size(); j++) {
+    NearEntry& e = blocks[j / NEAR_BLOCK_ENTRIES].entry[j % NEAR_BLOCK_ENTRIES];
+    e.lat = recs[set[j]].lat;
+    e.lon = recs[set[j]].lon;
+    e.index = set[j];
+  }
+  return set.size();
+}
+
+// Slot by slot, each task building the slots of one cell.
+std::vector<uint8_t> buildNearTable(const restaurant* recs, WorkPool* pool, NearStats* stats) {
+  static_assert(sizeof(NearEntry) == 12 && sizeof(NearBlock) == 512, "near table blocks are not laid out as on the Mega");
+
+  std::vector<std::vector<int> > rated(NEAR_RATINGS + 1);
+  for (int rating = 1; rating <= NEAR_RATINGS; rating++) {
+    for (int i = 0; i < NUM_RESTAURANTS; i++) {
+      if (starRating(recs[i]) >= rating) {
+        rated[rating].push_back(i);
+      }
+    }
+  }
+
+  std::vector<uint8_t> table(NEAR_TABLE_BYTES, 0);
+  std::vector<size_t> sizes(NEAR_TABLE_SLOTS);
+  pool->run(NEAR_CELLS * NEAR_CELLS, [&](size_t cell) {
+    int cx = cell % NEAR_CELLS, cy = cell / NEAR_CELLS;
+    for (int rating = 1; rating <= NEAR_RATINGS; rating++) {
+      sizes[nearSlot(cx, cy, rating)] = buildSlot(recs, rated[rating], cx, cy, rating, table.data());
+    }
+  });
+
+  *stats = NearStats();
+  for (size_t size : sizes) {
+    stats->sets++;
+    stats->entries += size;
+    stats->largest = std::max(stats->largest, size);
+    stats->overflows += size > NEAR_SLOT_ENTRIES;
+  }
+  return table;
+}
+
+std::vector<uint8_t> buildMarkerTable(const restaurant* recs) {
+  std::vector<uint8_t> table(MARKER_TABLE_BYTES, 0);
+  uint32_t magic = MARKER_TABLE_MAGIC;
+  memcpy(table.data(), &magic, sizeof(magic));
+
+  for (uint8_t zoom = 0; zoom < NUM_ZOOM_LEVELS; zoom++) {
+    int cols = MARKER_TILES_X(zoom), rows = MARKER_TILES_Y(zoom);
+    for (int rating = 1; rating <= MARKER_RATINGS; rating++) {
+      std::vector<uint32_t> count(cols * rows), sumX(cols * rows), sumY(cols * rows);
+      for (int i = 0; i < NUM_RESTAURANTS; i++) {
+        int16_t x = lon_to_x(recs[i].lon, zoom), y = lat_to_y(recs[i].lat, zoom);
+        if (starRating(recs[i]) < rating || x < 0 || x >= MAPWIDTH_AT(zoom) || y < 0 || y >= MAPHEIGHT_AT(zoom)) {
+          continue;
+        }
+        int t = (y >> MARKER_SHIFT) * cols + (x >> MARKER_SHIFT);
+        count[t]++;
+        sumX[t] += x & (MARKER_TILE - 1);
+        sumY[t] += y & (MARKER_TILE - 1);
+      }
+
+      TileMarker* grid = (TileMarker*) &table[(markerGridBlock(zoom, rating) - MARKER_TABLE_BLOCK) * 512];
+      for (int t = 0; t < cols * rows; t++) {
+        if (count[t] > 0) {
+          grid[t].count = count[t];
+          grid[t].meanX = (sumX[t] + count[t] / 2) / count[t];
+          grid[t].meanY = (sumY[t] + count[t] / 2) / count[t];
+        }
+      }
+    }
+  }
+  return table;
+}
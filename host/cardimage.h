@@ -0,0 +1,65 @@
+/*
+	The contents of the card after REST_START_BLOCK, built on the host as
+	the firmware reads them: the restaurants in rank order, then the name
+	index (../namesearch.h), then the near table (../neartable.h), then the
+	marker table (../tiles.h). Shared by cardrank, nameindex, neartable and
+	cardbuild.
+
+	A card image is a file holding the blocks of the card from
+	REST_START_BLOCK on.
+*/
+
+#ifndef _HOST_CARDIMAGE_H_
+#define _HOST_CARDIMAGE_H_
+
+#include <stddef.h>
+#include <vector>
+
+#include "restaurant.h"
+#include "namesearch.h"
+#include "neartable.h"
+#include "tiles.h"
+#include "workpool.h"
+
+// Where each part is in a card image, and its size, in bytes.
+#define RESTAURANT_BYTES ((size_t) NUM_RESTAURANTS * sizeof(restaurant))
+#define NAME_INDEX_OFFSET ((size_t) (NAME_INDEX_BLOCK - REST_START_BLOCK) * 512)
+#define NAME_INDEX_BYTES ((size_t) (1 + NAME_LEAVES) * 512)
+#define NEAR_TABLE_OFFSET ((size_t) (NEAR_TABLE_BLOCK - REST_START_BLOCK) * 512)
+#define NEAR_TABLE_SLOTS (NEAR_RATINGS * NEAR_CELLS * NEAR_CELLS)
+#define NEAR_TABLE_BYTES ((size_t) NEAR_TABLE_SLOTS * NEAR_SLOT_BLOCKS * 512)
+#define MARKER_TABLE_OFFSET ((size_t) (MARKER_TABLE_BLOCK - REST_START_BLOCK) * 512)
+#define MARKER_TABLE_BYTES ((size_t) MARKER_TABLE_BLOCKS * 512)
+
+// Reads a card image, returning false unless it holds NUM_RESTAURANTS
+// restaurants.
+bool readImage(const char* path, std::vector<uint8_t>& image);
+
+// Writes a card image, returning false if it could not be written.
+bool writeImage(const char* path, const std::vector<uint8_t>& image);
+
+// Copies part of the contents into the image at offset, growing it with
+// zeros if it is too short.
+void placeImage(std::vector<uint8_t>& image, size_t offset, const std::vector<uint8_t>& part);
+
+// Returns true if the image holds part at offset.
+bool imageHolds(const std::vector<uint8_t>& image, size_t offset, const std::vector<uint8_t>& part);
+
+// true if a is ranked before b: highest rating first, then by name.
+bool ranked(const restaurant& a, const restaurant& b);
+
+// The name index of the restaurants.
+std::vector<uint8_t> buildNameIndex(const restaurant* recs);
+
+// Sizes of the sets of a near table.
+struct NearStats {
+  size_t sets, entries, largest, overflows;
+};
+
+// The near table of the restaurants, its cells shared out over the pool.
+std::vector<uint8_t> buildNearTable(const restaurant* recs, WorkPool* pool, NearStats* stats);
+
+// The marker table of the restaurants.
+std::vector<uint8_t> buildMarkerTable(const restaurant* recs);
+
+#endif
@@ -0,0 +1,55 @@
+/*
+	Rewrites the restaurant records of a card image in rank order: highest
+	rating first, then by name. The list keys break ties in distance by the
+	index of the restaurant (see ../restaurant.h), so on a ranked card
+	restaurants at the same distance are listed by rating and then by name,
+	without the firmware reading anything more from the card to rank them.
+
+	Usage:
+		cardrank IN OUT     (writes the ranked image to OUT)
+		cardrank --check IN (exits 1 if IN is not in rank order)
+
+	The images hold the blocks of the card from REST_START_BLOCK on. Any
+	blocks after the restaurants are copied unchanged.
+*/
+
+#include <algorithm>
+#include <string>
+
+#include "cardimage.h"
+
+int main(int argc, char** argv) {
+  bool check = argc == 3 && std::string(argv[1]) == "--check";
+  if (argc != 3) {
+    fprintf(stderr, "usage: %s IN OUT | --check IN\n", argv[0]);
+    return 2;
+  }
+
+  const char* in = check ? argv[2] : argv[1];
+  std::vector<uint8_t> image;
+  if (!readImage(in, image)) {
+    fprintf(stderr, "cannot read %d restaurants from %s\n", NUM_RESTAURANTS, in);
+    return 2;
+  }
+
+  restaurant* recs = (restaurant*) image.data();
+  if (check) {
+    for (int i = 1; i < NUM_RESTAURANTS; i++) {
+      if (ranked(recs[i], recs[i - 1])) {
+        printf("%s is not ranked: restaurant %d (%s) comes before %d (%s)\n",
+               in, i - 1, recs[i - 1].name, i, recs[i].name);
+        return 1;
+      }
+    }
+    printf("%s is ranked\n", in);
+    return 0;
+  }
+
+  std::stable_sort(recs, recs + NUM_RESTAURANTS, ranked);
+
+  if (!writeImage(argv[2], image)) {
+    fprintf(stderr, "cannot write %s\n", argv[2]);
+    return 2;
+  }
+  return 0;
+}
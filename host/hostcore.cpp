@@ -0,0 +1,451 @@
+/*
+	Host implementations of the Arduino core and SD card stand-ins.
+*/
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include <Arduino.h>
+#include <SD.h>
+
+HardwareSerial Serial;
+SDClass SD;
+
+int hostAnalog[HOST_NUM_PINS];
+uint8_t hostDigital[HOST_NUM_PINS];
+
+// With nothing attached, the joystick rests in the centre and its button
+// (pulled up) is not pressed.
+static struct PinLevels {
+  PinLevels() {
+    for (int i = 0; i < HOST_NUM_PINS; i++) {
+      hostAnalog[i] = 512;
+      hostDigital[i] = HIGH;
+    }
+  }
+} pinLevels;
+
+static uint64_t nowNanos() {
+  timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return (uint64_t) t.tv_sec * 1000000000ull + t.tv_nsec;
+}
+
+static const uint64_t startNanos = nowNanos();
+
+long map(long x, long in_min, long in_max, long out_min, long out_max) {
+  return (x - in_min) * (out_max - out_min) / (in_max - in_min) + out_min;
+}
+
+static bool simulated = false;
+static uint64_t simulatedNanos = 0;
+static void (*clockHook)() = NULL;
+static bool inLane = false;
+static uint64_t laneNanos = 0;
+
+void hostUseSimulatedClock(void (*hook)()) {
+  simulated = true;
+  clockHook = hook;
+}
+
+void hostCharge(uint32_t nanos) {
+  if (inLane) {
+    laneNanos += nanos;
+  } else {
+    simulatedNanos += nanos;
+  }
+}
+
+void hostLaneBegin() {
+  inLane = true;
+  laneNanos = 0;
+}
+
+uint64_t hostLaneEnd() {
+  inLane = false;
+  return laneNanos;
+}
+
+uint64_t hostNanos() {
+  if (!simulated) {
+    return nowNanos() - startNanos;
+  }
+
+  // the hook may read the clock itself
+  static bool inHook = false;
+  simulatedNanos += HOST_CLOCK_READ_NS;
+  if (clockHook != NULL && !inHook) {
+    inHook = true;
+    clockHook();
+    inHook = false;
+  }
+  return simulatedNanos;
+}
+
+unsigned long millis() {
+  return hostNanos() / 1000000;
+}
+
+unsigned long micros() {
+  return hostNanos() / 1000;
+}
+
+void delay(unsigned long ms) {
+  if (simulated) {
+    simulatedNanos += ms * 1000000ull;
+  } else {
+    usleep(ms * 1000);
+  }
+}
+
+void delayMicroseconds(unsigned int us) {
+  if (simulated) {
+    simulatedNanos += us * 1000ull;
+  } else {
+    usleep(us);
+  }
+}
+
+void init() {}
+void pinMode(uint8_t, uint8_t) {}
+void digitalWrite(uint8_t, uint8_t) {}
+
+int digitalRead(uint8_t pin) {
+  return pin < HOST_NUM_PINS ? hostDigital[pin] : HIGH;
+}
+
+int analogRead(uint8_t pin) {
+  return pin < HOST_NUM_PINS ? hostAnalog[pin] : 512;
+}
+
+HardwareSerial::HardwareSerial() : out(stdout) {}
+void HardwareSerial::begin(long) {}
+void HardwareSerial::end() {}
+void HardwareSerial::setOutput(FILE* f) { out = f; }
+
+void HardwareSerial::flush() {
+  if (out) fflush(out);
+}
+
+size_t HardwareSerial::write(uint8_t c) {
+  if (out) fputc(c, out);
+  return 1;
+}
+
+size_t HardwareSerial::write(const uint8_t* buf, size_t n) {
+  if (out) fwrite(buf, 1, n, out);
+  return n;
+}
+
+// the host never has to wait for the port
+int HardwareSerial::availableForWrite() { return 64; }
+int HardwareSerial::available() { return 0; }
+int HardwareSerial::read() { return -1; }
+
+void HardwareSerial::print(const char* s) {
+  if (out) fputs(s, out);
+}
+
+void HardwareSerial::print(char c) {
+  write((uint8_t) c);
+}
+
+void HardwareSerial::print(unsigned char n, int base) {
+  print((unsigned long) n, base);
+}
+
+void HardwareSerial::print(int n, int base) {
+  print((long) n, base);
+}
+
+void HardwareSerial::print(unsigned int n, int base) {
+  print((unsigned long) n, base);
+}
+
+void HardwareSerial::print(long n, int base) {
+  if (n < 0 && base == DEC) {
+    print('-');
+    n = -n;
+  }
+  print((unsigned long) n, base);
+}
+
+void HardwareSerial::print(unsigned long n, int base) {
+  if (out) fprintf(out, base == HEX ? "%lX" : "%lu", n);
+}
+
+void HardwareSerial::println() {
+  print("\r\n");
+}
+
+// A file of the card, mapped into memory once however often it is opened.
+struct HostFile {
+  std::string path;
+  const uint8_t* data;
+  uint32_t size;
+  uint32_t first, count; // its raw blocks, count 0 until it is located
+};
+
+static std::vector<HostFile> hostFiles;
+static uint32_t nextFileBlock = HOST_FILE_BLOCK;
+
+// Stands in for the data of an empty file, which cannot be mapped.
+static const uint8_t emptyFile[1] = { 0 };
+
+// Maps a file read only, returning NULL if it cannot be.
+static const uint8_t* mapFile(const char* path, size_t* size) {
+  int fd = ::open(path, O_RDONLY);
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st) != 0) {
+    if (fd >= 0) close(fd);
+    return NULL;
+  }
+  *size = st.st_size;
+  void* data = st.st_size > 0 ? mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0) : (void*) emptyFile;
+  close(fd);
+  return data == MAP_FAILED ? NULL : (const uint8_t*) data;
+}
+
+// The file of the card with the given name, mapped if it is not yet, or
+// NULL if it cannot be read.
+static HostFile* hostFile(const char* name) {
+  char full[512];
+  snprintf(full, sizeof(full), "%s/%s", SD.getRoot(), name);
+  for (HostFile& f : hostFiles) {
+    if (f.path == full) {
+      return &f;
+    }
+  }
+
+  size_t size;
+  const uint8_t* data = mapFile(full, &size);
+  if (data == NULL) {
+    return NULL;
+  }
+  HostFile f = { full, data, (uint32_t) size, 0, 0 };
+  hostFiles.push_back(f);
+  return &hostFiles.back();
+}
+
+Sd2Card::Sd2Card()
+  : blockReads(0), commands(0), rate(SPI_FULL_SPEED), fastestGood(SPI_FULL_SPEED),
+    failEvery(0), transfers(0), mem(NULL), mapped(0), firstBlock(0), numBlocks(0),
+    streamNext(0) {}
+
+Sd2Card::~Sd2Card() {
+  if (mapped > 0) munmap((void*) mem, mapped);
+}
+
+uint8_t Sd2Card::init(uint8_t sckRateID, uint8_t) {
+  rate = sckRateID;
+  return mem != NULL;
+}
+
+uint8_t Sd2Card::setSckRate(uint8_t sckRateID) {
+  rate = sckRateID;
+  return 1;
+}
+
+void Sd2Card::setFaults(uint8_t good, uint32_t every) {
+  fastestGood = good;
+  failEvery = every;
+}
+
+bool Sd2Card::open(const char* path, uint32_t first) {
+  size_t size;
+  const uint8_t* data = mapFile(path, &size);
+  if (data == NULL) {
+    return false;
+  }
+  mem = data;
+  mapped = size;
+  numBlocks = size / 512;
+  firstBlock = first;
+  return true;
+}
+
+void Sd2Card::openMemory(const uint8_t* data, uint32_t blocks, uint32_t first) {
+  mem = data;
+  mapped = 0;
+  numBlocks = blocks;
+  firstBlock = first;
+}
+
+// Where the block is in the image or the file it is in, or NULL if the
+// card has no such block.
+const uint8_t* Sd2Card::blockAt(uint32_t block) {
+  for (const HostFile& f : hostFiles) {
+    if (f.count > 0 && block >= f.first && block - f.first < f.count) {
+      uint32_t offset = (block - f.first) * 512;
+      if (f.size - offset >= 512) {
+        return f.data + offset;
+      }
+      // the end of the last block of a file is padded with zeros
+      memset(scratch, 0, 512);
+      memcpy(scratch, f.data + offset, f.size - offset);
+      return scratch;
+    }
+  }
+
+  if (block < firstBlock || block - firstBlock >= numBlocks) {
+    return NULL;
+  }
+  return mem + (size_t) (block - firstBlock) * 512;
+}
+
+// Sends a block from the card at the clock it is set to, failing or
+// corrupting it as setFaults() asks. A corrupted block is a copy, so the
+// image is left as it is.
+const uint8_t* Sd2Card::transfer(uint32_t block) {
+  transfers++;
+  if (failEvery != 0 && transfers % failEvery == 0) {
+    return NULL;
+  }
+  if (rate < fastestGood && transfers % 2 == 0) {
+    return NULL;
+  }
+  const uint8_t* data = blockAt(block);
+  if (data == NULL) {
+    return NULL;
+  }
+  if (rate < fastestGood) {
+    if (data != scratch) {
+      memcpy(scratch, data, 512);
+    }
+    scratch[transfers % 512] ^= 0x10;
+    data = scratch;
+  }
+  blockReads++;
+  hostCharge((SD_TRANSFER_NS / 2) << rate);
+  return data;
+}
+
+const uint8_t* Sd2Card::mapBlock(uint32_t block, uint8_t* dst) {
+  commands++;
+  hostCharge(SD_COMMAND_NS);
+  const uint8_t* data = transfer(block);
+  if (data == scratch) {
+    memcpy(dst, data, 512);
+    return dst;
+  }
+  return data;
+}
+
+uint8_t Sd2Card::readBlock(uint32_t block, uint8_t* dst) {
+  const uint8_t* data = mapBlock(block, dst);
+  if (data == NULL) {
+    return 0;
+  }
+  if (data != dst) {
+    memcpy(dst, data, 512);
+  }
+  return 1;
+}
+
+bool Sd2Card::readStart(uint32_t block) {
+  commands++;
+  hostCharge(SD_COMMAND_NS);
+  streamNext = block;
+  return true;
+}
+
+const uint8_t* Sd2Card::mapData() {
+  const uint8_t* data = transfer(streamNext);
+  if (data != NULL) {
+    streamNext++;
+  }
+  return data;
+}
+
+bool Sd2Card::readData(uint8_t* dst) {
+  const uint8_t* data = mapData();
+  if (data == NULL) {
+    return false;
+  }
+  memcpy(dst, data, 512);
+  return true;
+}
+
+bool Sd2Card::readStop() {
+  commands++;
+  hostCharge(SD_STOP_NS);
+  return true;
+}
+
+bool Sd2Card::locate(const char* name, uint32_t* first, uint32_t* count) {
+  HostFile* f = hostFile(name);
+  if (f == NULL) {
+    return false;
+  }
+  if (f->count == 0) {
+    f->first = nextFileBlock;
+    f->count = (f->size + 511) / 512;
+    nextFileBlock += f->count;
+  }
+
+  *first = f->first;
+  *count = f->count;
+  return true;
+}
+
+int File::read(void* buf, uint16_t n) {
+  if (data == NULL) {
+    return -1;
+  }
+  uint32_t got = min((uint32_t) n, length - min(pos, length));
+  if (got == 0) {
+    return 0;
+  }
+  memcpy(buf, data + pos, got);
+  for (uint32_t b = pos / 512; b <= (pos + got - 1) / 512; b++) {
+    if (b != cached) {
+      SD.commands++;
+      hostCharge(SD_COMMAND_NS + SD_TRANSFER_NS);
+      cached = b;
+    }
+  }
+  pos += got;
+  return got;
+}
+
+bool File::seek(uint32_t to) {
+  hostCharge(SD_SEEK_NS);
+  if (data == NULL || to > length) {
+    return false;
+  }
+  pos = to;
+  return true;
+}
+
+uint32_t File::position() {
+  return pos;
+}
+
+uint32_t File::size() {
+  return length;
+}
+
+int File::available() {
+  return size() - position();
+}
+
+void File::close() {
+  data = NULL;
+}
+
+bool SDClass::begin(uint8_t) {
+  struct stat st;
+  return stat(root, &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+File SDClass::open(const char* path, uint8_t) {
+  hostCharge(SD_OPEN_NS);
+  HostFile* f = hostFile(path);
+  return f != NULL ? File(f->data, f->size) : File();
+}
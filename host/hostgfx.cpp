@@ -0,0 +1,269 @@
+/*
+	Host implementations of the display and touchscreen stand-ins.
+*/
+
+#include <Adafruit_GFX.h>
+#include <MCUFRIEND_kbv.h>
+#include <TouchScreen.h>
+
+TSPoint hostTouch;
+
+TSPoint TouchScreen::getPoint() {
+  return hostTouch;
+}
+
+Adafruit_GFX::Adafruit_GFX(int16_t w, int16_t h)
+  : WIDTH(w), HEIGHT(h), _width(w), _height(h), rotation(0), cursor_x(0), cursor_y(0),
+    textcolor(0xFFFF), textbgcolor(0xFFFF), textsize(1), wrap(true) {}
+
+void Adafruit_GFX::setRotation(uint8_t r) {
+  rotation = r & 3;
+  _width = (rotation & 1) ? HEIGHT : WIDTH;
+  _height = (rotation & 1) ? WIDTH : HEIGHT;
+}
+
+void Adafruit_GFX::fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) {
+  for (int16_t i = x; i < x + w; i++) {
+    drawFastVLine(i, y, h, color);
+  }
+}
+
+void Adafruit_GFX::fillScreen(uint16_t color) {
+  fillRect(0, 0, _width, _height, color);
+}
+
+void Adafruit_GFX::drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color) {
+  fillRect(x, y, w, 1, color);
+}
+
+void Adafruit_GFX::drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color) {
+  for (int16_t j = y; j < y + h; j++) {
+    drawPixel(x, j, color);
+  }
+}
+
+void Adafruit_GFX::drawRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) {
+  drawFastHLine(x, y, w, color);
+  drawFastHLine(x, y + h - 1, w, color);
+  drawFastVLine(x, y, h, color);
+  drawFastVLine(x + w - 1, y, h, color);
+}
+
+// Both circles walk the first octant with the midpoint algorithm, as the
+// library does, so they cover the same pixels.
+void Adafruit_GFX::drawCircle(int16_t x0, int16_t y0, int16_t r, uint16_t color) {
+  int16_t f = 1 - r, ddF_x = 1, ddF_y = -2 * r, x = 0, y = r;
+
+  drawPixel(x0, y0 + r, color);
+  drawPixel(x0, y0 - r, color);
+  drawPixel(x0 + r, y0, color);
+  drawPixel(x0 - r, y0, color);
+
+  while (x < y) {
+    if (f >= 0) {
+      y--;
+      ddF_y += 2;
+      f += ddF_y;
+    }
+    x++;
+    ddF_x += 2;
+    f += ddF_x;
+
+    drawPixel(x0 + x, y0 + y, color);
+    drawPixel(x0 - x, y0 + y, color);
+    drawPixel(x0 + x, y0 - y, color);
+    drawPixel(x0 - x, y0 - y, color);
+    drawPixel(x0 + y, y0 + x, color);
+    drawPixel(x0 - y, y0 + x, color);
+    drawPixel(x0 + y, y0 - x, color);
+    drawPixel(x0 - y, y0 - x, color);
+  }
+}
+
+void Adafruit_GFX::fillCircle(int16_t x0, int16_t y0, int16_t r, uint16_t color) {
+  int16_t f = 1 - r, ddF_x = 1, ddF_y = -2 * r, x = 0, y = r;
+  int16_t px = x, py = y;
+
+  drawFastVLine(x0, y0 - r, 2 * r + 1, color);
+
+  while (x < y) {
+    if (f >= 0) {
+      y--;
+      ddF_y += 2;
+      f += ddF_y;
+    }
+    x++;
+    ddF_x += 2;
+    f += ddF_x;
+
+    // skip lines the previous step already drew
+    if (x < y + 1) {
+      drawFastVLine(x0 + x, y0 - y, 2 * y + 1, color);
+      drawFastVLine(x0 - x, y0 - y, 2 * y + 1, color);
+    }
+    if (y != py) {
+      drawFastVLine(x0 + py, y0 - px, 2 * px + 1, color);
+      drawFastVLine(x0 - py, y0 - px, 2 * px + 1, color);
+      py = y;
+    }
+    px = x;
+  }
+}
+
+// Five columns of seven pixels standing in for the glyph of a character.
+static uint8_t glyphColumn(unsigned char c, int i) {
+  if (c == ' ') {
+    return 0;
+  }
+  uint32_t h = c * 2654435761u;
+  return ((h >> (i * 5)) & 0x7F) | (i == 2 ? 0x41 : 0);
+}
+
+GFXcanvas1::GFXcanvas1(uint16_t w, uint16_t h)
+  : Adafruit_GFX(w, h), buffer((uint8_t*) calloc((w + 7) / 8 * h, 1)) {}
+
+GFXcanvas1::~GFXcanvas1() {
+  free(buffer);
+}
+
+void GFXcanvas1::drawPixel(int16_t x, int16_t y, uint16_t color) {
+  if (x < 0 || x >= _width || y < 0 || y >= _height) {
+    return;
+  }
+  uint8_t* b = &buffer[(x / 8) + y * ((WIDTH + 7) / 8)];
+  if (color) {
+    *b |= 0x80 >> (x & 7);
+  } else {
+    *b &= ~(0x80 >> (x & 7));
+  }
+}
+
+void GFXcanvas1::fillScreen(uint16_t color) {
+  memset(buffer, color ? 0xFF : 0x00, (WIDTH + 7) / 8 * HEIGHT);
+}
+
+void Adafruit_GFX::drawChar(int16_t x, int16_t y, unsigned char c, uint16_t color,
+                            uint16_t bg, uint8_t size) {
+  if (x >= _width || y >= _height || x + 6 * size - 1 < 0 || y + 8 * size - 1 < 0) {
+    return;
+  }
+
+  for (int i = 0; i < 6; i++) {
+    uint8_t line = (i < 5) ? glyphColumn(c, i) : 0;
+    for (int j = 0; j < 8; j++, line >>= 1) {
+      if (line & 1) {
+        fillRect(x + i * size, y + j * size, size, size, color);
+      } else if (bg != color) {
+        fillRect(x + i * size, y + j * size, size, size, bg);
+      }
+    }
+  }
+}
+
+size_t Adafruit_GFX::write(uint8_t c) {
+  if (c == '\n') {
+    cursor_x = 0;
+    cursor_y += 8 * textsize;
+  } else if (c != '\r') {
+    if (wrap && cursor_x + 6 * textsize > _width) {
+      cursor_x = 0;
+      cursor_y += 8 * textsize;
+    }
+    drawChar(cursor_x, cursor_y, c, textcolor, textbgcolor, textsize);
+    cursor_x += 6 * textsize;
+  }
+  return 1;
+}
+
+void Adafruit_GFX::print(const char* s) {
+  while (*s) {
+    write(*s++);
+  }
+}
+
+void Adafruit_GFX::print(char c) {
+  write(c);
+}
+
+void Adafruit_GFX::print(int n) {
+  print((long) n);
+}
+
+void Adafruit_GFX::print(unsigned int n) {
+  print((unsigned long) n);
+}
+
+void Adafruit_GFX::print(long n) {
+  char buf[24];
+  snprintf(buf, sizeof(buf), "%ld", n);
+  print(buf);
+}
+
+void Adafruit_GFX::print(unsigned long n) {
+  char buf[24];
+  snprintf(buf, sizeof(buf), "%lu", n);
+  print(buf);
+}
+
+MCUFRIEND_kbv::MCUFRIEND_kbv()
+  : Adafruit_GFX(320, 480), pixelsWritten(0),
+    winX0(0), winY0(0), winX1(0), winY1(0), winX(0), winY(0) {
+  memset(fb, 0, sizeof(fb));
+}
+
+void MCUFRIEND_kbv::setRotation(uint8_t r) {
+  Adafruit_GFX::setRotation(r);
+}
+
+void MCUFRIEND_kbv::put(int16_t x, int16_t y, uint16_t color) {
+  if (x >= 0 && x < _width && y >= 0 && y < _height) {
+    fb[(int32_t) y * _width + x] = color;
+    pixelsWritten++;
+  }
+}
+
+void MCUFRIEND_kbv::drawPixel(int16_t x, int16_t y, uint16_t color) {
+  put(x, y, color);
+  hostCharge(TFT_PIXEL_NS);
+}
+
+void MCUFRIEND_kbv::fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) {
+  int16_t x1 = min(x + w, _width), y1 = min(y + h, _height);
+  x = max(x, 0);
+  y = max(y, 0);
+  if (x >= x1 || y >= y1) {
+    return;
+  }
+
+  for (int16_t j = y; j < y1; j++) {
+    for (int16_t i = x; i < x1; i++) {
+      put(i, j, color);
+    }
+  }
+  hostCharge(TFT_WINDOW_NS + (uint32_t) (x1 - x) * (y1 - y) * TFT_PUSH_NS);
+}
+
+void MCUFRIEND_kbv::fillScreen(uint16_t color) {
+  fillRect(0, 0, _width, _height, color);
+}
+
+void MCUFRIEND_kbv::setAddrWindow(int16_t x0, int16_t y0, int16_t x1, int16_t y1) {
+  winX0 = winX = x0;
+  winY0 = winY = y0;
+  winX1 = x1;
+  winY1 = y1;
+  hostCharge(TFT_WINDOW_NS);
+}
+
+void MCUFRIEND_kbv::pushColors(uint16_t* block, int16_t n, bool first) {
+  for (int16_t k = 0; k < n; k++) {
+    put(winX, winY, block[k]);
+    if (++winX > winX1) {
+      winX = winX0;
+      if (++winY > winY1) {
+        winY = winY0;
+      }
+    }
+  }
+  hostCharge((uint32_t) n * TFT_PUSH_NS);
+}
@@ -0,0 +1,323 @@
+/*
+	Host benchmark of the distance metrics.
+
+	Checks the integer kernels the firmware uses against floating point
+	references: the Euclidean distance against the exact one over every
+	offset on the full size map, and the travel time against the cell
+	weights integrated finely along the way. For each cursor of the workload
+	it then ranks the restaurants by each kernel and by its reference, and
+	counts how many of the first page the two agree on. One JSON object is
+	printed per metric with the errors, the mean first page overlap, and the
+	time per call in nanoseconds.
+
+	It then checks each scan kernel the CPU runs (scankernel.h) against the
+	scan of the list build, on a synthetic dataset of --scan restaurants
+	uniform over the map with ratings uniform from 0 to 10, for each cursor
+	of the workload and each rating in turn. One JSON object is printed per
+	kernel with the number of queries whose list differed, the time per
+	restaurant scanned in nanoseconds, and the speedup over the scalar
+	kernel.
+
+	Usage:
+		metricbench [options]
+
+	Options:
+		--card FILE  card image starting at REST_START_BLOCK (default: synthetic data)
+		--queries N  number of cursors, uniform over the map (default 200)
+		--zoom Z     zoom level the distances are measured at (default 0)
+		--seed S     seed for the synthetic data and cursors (default 1)
+		--scan N     restaurants the scan kernels are run over (default 100000, 0 for none)
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include "restaurant.h"
+#include "scankernel.h"
+
+// points sampled along the way by the travel time reference
+#define REFERENCE_SAMPLES 256
+
+// calls timed per metric
+#define TIMED_CALLS 2000000
+
+struct Point {
+  int16_t x, y;
+};
+
+struct Report {
+  double maxError, meanError; // absolute for Euclidean, relative for travel time
+  double overlap;             // mean number of the first page both rankings hold
+  double ns;                  // time per call
+};
+
+// keeps the timed calls from being optimised away
+static volatile uint32_t sink;
+
+static double euclideanReference(int x1, int y1, int x2, int y2) {
+  return std::hypot(x1 - x2, y1 - y2);
+}
+
+static double travelReference(int x1, int y1, int x2, int y2, uint8_t zoom) {
+  double weights = 0;
+  for (int k = 0; k < REFERENCE_SAMPLES; k++) {
+    double t = (k + 0.5) / REFERENCE_SAMPLES;
+    int cx = constrain((int) ((x1 + t * (x2 - x1)) * (1 << zoom)) >> TRAVEL_SHIFT, 0, TRAVEL_CELLS - 1);
+    int cy = constrain((int) ((y1 + t * (y2 - y1)) * (1 << zoom)) >> TRAVEL_SHIFT, 0, TRAVEL_CELLS - 1);
+    weights += travelWeights[cy][cx];
+  }
+  return (abs(x1 - x2) + abs(y1 - y2)) * weights / (REFERENCE_SAMPLES * TRAVEL_UNIT);
+}
+
+static double reference(uint8_t metric, int x1, int y1, int x2, int y2, uint8_t zoom) {
+  switch (metric) {
+    case EUCLIDEAN:
+      return euclideanReference(x1, y1, x2, y2);
+    case TRAVEL_TIME:
+      return travelReference(x1, y1, x2, y2, zoom);
+    default:
+      return abs(x1 - x2) + abs(y1 - y2);
+  }
+}
+
+// Every offset of the full size map, since the kernel must be exact there.
+static void checkEuclidean(Report* r) {
+  double sum = 0;
+  uint32_t wrong = 0;
+  for (int dx = 0; dx < MAPWIDTH; dx++) {
+    for (int dy = 0; dy < MAPHEIGHT; dy++) {
+      uint16_t d = euclidean(0, 0, dx, dy);
+      double exact = euclideanReference(0, 0, dx, dy);
+      if (d != (uint16_t) std::floor(exact)) wrong++;
+      r->maxError = std::max(r->maxError, exact - d);
+      sum += exact - d;
+    }
+  }
+  r->meanError = sum / ((double) MAPWIDTH * MAPHEIGHT);
+  if (wrong) {
+    fprintf(stderr, "euclidean is not the rounded down distance at %u offsets\n", wrong);
+  }
+}
+
+static void checkTravelTime(const std::vector<Point>& pts, const std::vector<Point>& cursors,
+                            uint8_t zoom, Report* r) {
+  double sum = 0;
+  size_t n = 0;
+  for (const Point& c : cursors) {
+    for (const Point& p : pts) {
+      double exact = travelReference(p.x, p.y, c.x, c.y, zoom);
+      if (exact < 1) continue;
+      double err = std::fabs(travelTime(p.x, p.y, c.x, c.y, zoom) - exact) / exact;
+      r->maxError = std::max(r->maxError, err);
+      sum += err;
+      n++;
+    }
+  }
+  r->meanError = n ? sum / n : 0;
+}
+
+// Mean number of restaurants the first pages by the kernel and by its
+// reference have in common.
+static double firstPageOverlap(uint8_t metric, const std::vector<Point>& pts,
+                               const std::vector<Point>& cursors, uint8_t zoom) {
+  std::vector<RestDist> keys(pts.size());
+  std::vector<std::pair<double, int> > exact(pts.size());
+  size_t page = std::min(pts.size(), (size_t) REST_PAGE_SIZE);
+  double total = 0;
+
+  for (const Point& c : cursors) {
+    for (size_t i = 0; i < pts.size(); i++) {
+      keys[i] = restKey(i, distance(metric, pts[i].x, pts[i].y, c.x, c.y, zoom));
+      exact[i] = std::make_pair(reference(metric, pts[i].x, pts[i].y, c.x, c.y, zoom), (int) i);
+    }
+    std::partial_sort(keys.begin(), keys.begin() + page, keys.end());
+    std::partial_sort(exact.begin(), exact.begin() + page, exact.end());
+
+    std::vector<int> a, b;
+    for (size_t k = 0; k < page; k++) {
+      a.push_back(restIndex(keys[k]));
+      b.push_back(exact[k].second);
+    }
+    std::sort(a.begin(), a.end());
+    std::sort(b.begin(), b.end());
+    std::vector<int> both;
+    std::set_intersection(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(both));
+    total += both.size();
+  }
+  return cursors.empty() ? 0 : total / cursors.size();
+}
+
+static double nsPerCall(uint8_t metric, const std::vector<Point>& pts, uint8_t zoom) {
+  uint32_t acc = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < TIMED_CALLS; i++) {
+    const Point& p = pts[i % pts.size()];
+    const Point& q = pts[(i * 7 + 3) % pts.size()];
+    acc += distance(metric, p.x, p.y, q.x, q.y, zoom);
+  }
+  sink = acc;
+  return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count()
+         / TIMED_CALLS;
+}
+
+static std::vector<Point> cardPoints(Sd2Card* card, uint8_t zoom) {
+  std::vector<Point> pts(NUM_RESTAURANTS);
+  RestCache cache;
+  cache.cachedBlock = 0;
+  for (int i = 0; i < NUM_RESTAURANTS; i++) {
+    restaurant r;
+    getRestaurant(&r, i, card, &cache);
+    pts[i].x = lon_to_x(r.lon, zoom);
+    pts[i].y = lat_to_y(r.lat, zoom);
+  }
+  return pts;
+}
+
+static std::vector<Point> uniformPoints(size_t n, uint8_t zoom) {
+  std::vector<Point> pts(n);
+  for (size_t i = 0; i < n; i++) {
+    pts[i].x = rand() % MAPWIDTH_AT(zoom);
+    pts[i].y = rand() % MAPHEIGHT_AT(zoom);
+  }
+  return pts;
+}
+
+// Restaurants uniform over the full size map, rated uniformly from 0 to 10.
+static std::vector<restaurant> uniformRestaurants(size_t n) {
+  std::vector<restaurant> recs(n);
+  for (restaurant& r : recs) {
+    memset(&r, 0, sizeof(r));
+    r.lat = LATSOUTH + rand() % (LATNORTH - LATSOUTH);
+    r.lon = LONWEST + rand() % (LONEAST - LONWEST);
+    r.rating = rand() % 11;
+  }
+  return recs;
+}
+
+// The keys of the restaurants as the scan of the list build makes them.
+static size_t referenceScan(const std::vector<restaurant>& recs, int16_t cx, int16_t cy, uint8_t zoom,
+                            int rating, RestDist keys[]) {
+  size_t out = 0;
+  for (size_t i = 0; i < recs.size(); i++) {
+    if (starRating(recs[i]) >= rating) {
+      keys[out++] = restKey(i, distance(MANHATTAN, lon_to_x(recs[i].lon, zoom), lat_to_y(recs[i].lat, zoom),
+                                        cx, cy, zoom));
+    }
+  }
+  return out;
+}
+
+// Checks and times each scan kernel over n synthetic restaurants.
+static void benchScanKernels(size_t n, const std::vector<Point>& cursors, uint8_t zoom) {
+  n = std::min(n, (size_t) REST_INDEX_MASK + 1);
+  std::vector<restaurant> recs = uniformRestaurants(n);
+  ScanSet set;
+  buildScanSet(&set, recs.data(), n);
+  std::vector<RestDist> want(n), got(n);
+
+  double scalarNs = 0;
+  for (int kernel = 0; kernel < NUM_SCAN_KERNELS; kernel++) {
+    if (!scanKernelSupported(kernel)) {
+      continue;
+    }
+
+    size_t wrong = 0;
+    for (size_t q = 0; q < cursors.size(); q++) {
+      int rating = 1 + q % 5;
+      size_t count = referenceScan(recs, cursors[q].x, cursors[q].y, zoom, rating, want.data());
+      if (scanManhattan(kernel, set, cursors[q].x, cursors[q].y, zoom, rating, got.data()) != count ||
+          !std::equal(want.begin(), want.begin() + count, got.begin())) {
+        wrong++;
+      }
+    }
+
+    // every query scans all n, so the time is per restaurant whatever passes
+    uint32_t acc = 0;
+    int rounds = std::max<size_t>(1, TIMED_CALLS / n);
+    auto start = std::chrono::steady_clock::now();
+    for (int k = 0; k < rounds; k++) {
+      for (size_t q = 0; q < cursors.size(); q++) {
+        acc += scanManhattan(kernel, set, cursors[q].x, cursors[q].y, zoom, 1 + q % 5, got.data());
+      }
+    }
+    sink = acc;
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count()
+                / ((double) rounds * cursors.size() * n);
+    if (kernel == SCAN_SCALAR) {
+      scalarNs = ns;
+    }
+
+    printf("{\"dataset\":\"synthetic\",\"kernel\":\"%s\",\"restaurants\":%zu,\"zoom\":%d,\"queries\":%zu,"
+           "\"mismatches\":%zu,\"ns_per_restaurant\":%.3f,\"speedup\":%.2f}\n",
+           scanKernelNames[kernel], n, zoom, cursors.size(), wrong, ns, scalarNs / ns);
+    if (wrong) {
+      fprintf(stderr, "the %s scan kernel differs from the list build on %zu queries\n", scanKernelNames[kernel],
+              wrong);
+    }
+  }
+}
+
+int main(int argc, char** argv) {
+  const char* metricNames[NUM_METRICS] = { "manhattan", "euclidean", "travel_time" };
+  const char* cardPath = NULL;
+  int queries = 200, zoom = 0;
+  size_t scan = 100000;
+  unsigned seed = 1;
+
+  for (int i = 1; i < argc; i++) {
+    std::string a = argv[i];
+    bool more = i + 1 < argc;
+    if (a == "--card" && more) cardPath = argv[++i];
+    else if (a == "--queries" && more) queries = atoi(argv[++i]);
+    else if (a == "--zoom" && more) zoom = constrain(atoi(argv[++i]), 0, NUM_ZOOM_LEVELS - 1);
+    else if (a == "--seed" && more) seed = atoi(argv[++i]);
+    else if (a == "--scan" && more) scan = atol(argv[++i]);
+    else {
+      fprintf(stderr, "usage: %s [--card FILE] [--queries N] [--zoom Z] [--seed S] [--scan N]\n", argv[0]);
+      return 2;
+    }
+  }
+
+  srand(seed);
+  Sd2Card card;
+  std::vector<Point> pts;
+  std::string dataset;
+  if (cardPath) {
+    if (!card.open(cardPath, REST_START_BLOCK)) {
+      fprintf(stderr, "cannot open card image %s\n", cardPath);
+      return 1;
+    }
+    Serial.setOutput(NULL);
+    pts = cardPoints(&card, zoom);
+    Serial.setOutput(stdout);
+    dataset = "card";
+  } else {
+    pts = uniformPoints(NUM_RESTAURANTS, zoom);
+    dataset = "synthetic";
+  }
+  std::vector<Point> cursors = uniformPoints(queries, zoom);
+
+  for (int m = 0; m < NUM_METRICS; m++) {
+    Report r = { 0, 0, 0, 0 };
+    if (m == EUCLIDEAN) {
+      checkEuclidean(&r);
+    } else if (m == TRAVEL_TIME) {
+      checkTravelTime(pts, cursors, zoom, &r);
+    }
+    r.overlap = firstPageOverlap(m, pts, cursors, zoom);
+    r.ns = nsPerCall(m, pts, zoom);
+
+    printf("{\"dataset\":\"%s\",\"metric\":\"%s\",\"zoom\":%d,\"queries\":%zu,"
+           "\"max_error\":%.4f,\"mean_error\":%.4f,\"first_page_overlap\":%.2f,\"ns_per_call\":%.1f}\n",
+           dataset.c_str(), metricNames[m], zoom, cursors.size(), r.maxError, r.meanError,
+           r.overlap, r.ns);
+  }
+
+  if (scan > 0) {
+    benchScanKernels(scan, cursors, zoom);
+  }
+  return 0;
+}
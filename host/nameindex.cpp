@@ -0,0 +1,50 @@
+/*
+	Writes the name index the firmware searches (see ../namesearch.h) into
+	a card image, after the restaurants. Run it after cardrank, since the
+	index holds the positions of the restaurants on the card.
+
+	Usage:
+		nameindex IN OUT     (writes the image with the index to OUT)
+		nameindex --check IN (exits 1 if IN has no index, or it is out of date)
+
+	The images hold the blocks of the card from REST_START_BLOCK on. Any
+	blocks after the index are copied unchanged.
+*/
+
+#include <string>
+
+#include "cardimage.h"
+
+int main(int argc, char** argv) {
+  bool check = argc == 3 && std::string(argv[1]) == "--check";
+  if (argc != 3) {
+    fprintf(stderr, "usage: %s IN OUT | --check IN\n", argv[0]);
+    return 2;
+  }
+
+  const char* in = check ? argv[2] : argv[1];
+  std::vector<uint8_t> image;
+  if (!readImage(in, image)) {
+    fprintf(stderr, "cannot read %d restaurants from %s\n", NUM_RESTAURANTS, in);
+    return 2;
+  }
+
+  std::vector<uint8_t> index = buildNameIndex((const restaurant*) image.data());
+  if (check) {
+    if (!imageHolds(image, NAME_INDEX_OFFSET, index)) {
+      printf("%s has no name index, or it does not match the restaurants\n", in);
+      return 1;
+    }
+    printf("%s has an up to date name index\n", in);
+    return 0;
+  }
+
+  placeImage(image, NAME_INDEX_OFFSET, index);
+  if (!writeImage(argv[2], image)) {
+    fprintf(stderr, "cannot write %s\n", argv[2]);
+    return 2;
+  }
+  printf("wrote %d names in %d blocks from block %lu\n", NUM_RESTAURANTS, 1 + NAME_LEAVES,
+         (unsigned long) NAME_INDEX_BLOCK);
+  return 0;
+}
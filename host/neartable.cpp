@@ -0,0 +1,62 @@
+/*
+	Writes the near table the list build reads its first page from (see
+	../neartable.h) into a card image, after the name index. Run it after
+	cardrank, since the table holds the positions of the restaurants on the
+	card.
+
+	Usage:
+		neartable [--threads N] IN OUT     (writes the image with the table to OUT)
+		neartable [--threads N] --check IN (exits 1 if IN has no table, or it is out of date)
+
+	The images hold the blocks of the card from REST_START_BLOCK on. Any
+	blocks after the table are copied unchanged.
+
+	The cells are shared out over a thread per core, or --threads N.
+*/
+
+#include <string>
+
+#include "cardimage.h"
+
+int main(int argc, char** argv) {
+  int threads = 0;
+  int arg = 1;
+  if (argc > 2 && std::string(argv[1]) == "--threads") {
+    threads = atoi(argv[2]);
+    arg = 3;
+  }
+  bool check = argc - arg == 2 && std::string(argv[arg]) == "--check";
+  if (argc - arg != 2) {
+    fprintf(stderr, "usage: %s [--threads N] IN OUT | [--threads N] --check IN\n", argv[0]);
+    return 2;
+  }
+
+  const char* in = check ? argv[arg + 1] : argv[arg];
+  std::vector<uint8_t> image;
+  if (!readImage(in, image)) {
+    fprintf(stderr, "cannot read %d restaurants from %s\n", NUM_RESTAURANTS, in);
+    return 2;
+  }
+
+  WorkPool pool(threads);
+  NearStats stats;
+  std::vector<uint8_t> table = buildNearTable((const restaurant*) image.data(), &pool, &stats);
+  if (check) {
+    if (!imageHolds(image, NEAR_TABLE_OFFSET, table)) {
+      printf("%s has no near table, or it does not match the restaurants\n", in);
+      return 1;
+    }
+    printf("%s has an up to date near table\n", in);
+    return 0;
+  }
+
+  placeImage(image, NEAR_TABLE_OFFSET, table);
+  if (!writeImage(argv[arg + 1], image)) {
+    fprintf(stderr, "cannot write %s\n", argv[arg + 1]);
+    return 2;
+  }
+  printf("wrote %zu sets of %.1f restaurants on average (largest %zu, %zu too large for a slot)\n",
+         stats.sets, (double) stats.entries / stats.sets, stats.largest, stats.overflows);
+  printf("in %d blocks from block %lu\n", NEAR_TABLE_SLOTS * NEAR_SLOT_BLOCKS, (unsigned long) NEAR_TABLE_BLOCK);
+  return 0;
+}
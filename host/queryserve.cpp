@@ -0,0 +1,294 @@
+/*
+	Answers batches of "nearest restaurants" queries from a card image,
+	ranking them with the list build of the firmware (startList() and
+	stepList(), as getAndSortRestaurants() runs them) on the restaurants in
+	memory, so the answers are the lists the firmware would show.
+
+	Usage:
+		queryserve [options] CARD
+
+	Options:
+		--threads N     threads to answer the queries of a batch (default one per core)
+		--socket PATH   serve batches to connections on a Unix socket at PATH
+		                rather than from stdin
+		--sort ENGINE   quick (default), insertion or both, as the sort button picks
+		--kernel K      scan kernel for the Manhattan metric: scalar, sse2 or avx2
+		                (default the fastest the CPU runs, see scankernel.h)
+
+	CARD is a card image holding the blocks of the card from REST_START_BLOCK
+	on, mapped into memory. Each line of a batch is a query:
+
+		x y rating [n [metric [zoom]]]
+
+	for the n (default REST_PAGE_SIZE) nearest restaurants of at least the
+	rating (1 to 5 stars) to the point (x, y) of the full size map, by the
+	metric (manhattan, euclidean or travel, default manhattan) at the zoom
+	level (default 0). A batch ends at a blank line or the end of the input.
+	The answer to each query is a line "query rank index distance name" for
+	each restaurant, in the order of the queries, and a blank line ends the
+	answer to the batch. Lines starting with '#' are skipped.
+
+	Each thread has its own list build and list, so the queries of a batch
+	run in parallel. By the Manhattan metric the scan of the list build is
+	done by a vector kernel, which keys the restaurants as the scan does.
+	The selection of the first page and the sort are as in the firmware.
+	After each batch the number of queries, queries per second and the
+	latency distribution go to stderr.
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "cardimage.h"
+#include "scankernel.h"
+
+struct Query {
+  MapView mv;
+  int8_t rating;
+  int8_t metric;
+  int16_t n;
+};
+
+// The answer to a query: its restaurants, nearest first, and how long it
+// took.
+struct Answer {
+  std::vector<RestDist> nearest;
+  double us;
+};
+
+// What the queries are answered from and how.
+struct Engine {
+  const restaurant* recs; // the NUM_RESTAURANTS restaurants of the card
+  ScanSet set;            // the same, for the scan kernel
+  int kernel;
+  int sortMode;
+};
+
+static const char* const metricNames[NUM_METRICS] = { "manhattan", "euclidean", "travel" };
+
+// Parses a query, returning false if the line is not one.
+static bool parseQuery(const char* line, Query* q) {
+  int x, y, rating, n = REST_PAGE_SIZE, zoom = 0;
+  char metric[16] = "manhattan";
+  int fields = sscanf(line, "%d %d %d %d %15s %d", &x, &y, &rating, &n, metric, &zoom);
+  if (fields < 3 || x < 0 || x >= MAPWIDTH || y < 0 || y >= MAPHEIGHT ||
+      rating < 1 || rating > 5 || n < 1 || zoom < 0 || zoom >= NUM_ZOOM_LEVELS) {
+    return false;
+  }
+
+  q->metric = -1;
+  for (int m = 0; m < NUM_METRICS; m++) {
+    if (strcmp(metric, metricNames[m]) == 0) {
+      q->metric = m;
+    }
+  }
+  if (q->metric < 0) {
+    return false;
+  }
+
+  // the cursor at the upper left of the display, on the point at the zoom level
+  q->mv.mapX = q->mv.mapY = 0;
+  q->mv.cursorX = rezoom(x, 0, zoom);
+  q->mv.cursorY = rezoom(y, 0, zoom);
+  q->mv.zoom = zoom;
+  q->rating = rating;
+  q->n = std::min(n, NUM_RESTAURANTS);
+  return true;
+}
+
+// Answers a query with the list build of the firmware, in a list of the
+// thread's own.
+static void answer(const Query& q, const Engine& e, Answer* a) {
+  thread_local std::vector<RestDist> list(NUM_RESTAURANTS);
+  auto start = std::chrono::steady_clock::now();
+
+  ListBuild lb;
+  startList(&lb, q.mv, q.rating, e.sortMode, q.metric);
+  listFromMemory(&lb, e.recs);
+  if (q.metric == MANHATTAN) {
+    // the scan by the kernel, leaving the build to select and sort
+    lb.count = scanManhattan(e.kernel, e.set, q.mv.mapX + q.mv.cursorX, q.mv.mapY + q.mv.cursorY, q.mv.zoom,
+                             q.rating, list.data());
+    lb.next = NUM_RESTAURANTS;
+  }
+  stepList(&lb, list.data(), NULL, NULL, NO_BUDGET);
+
+  a->nearest.assign(list.begin(), list.begin() + std::min<int>(q.n, lb.count));
+  a->us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+}
+
+static double percentile(std::vector<double> v, double p) {
+  if (v.empty()) return 0;
+  std::sort(v.begin(), v.end());
+  return v[std::min(v.size() - 1, (size_t) (p * (v.size() - 1) + 0.5))];
+}
+
+// Answers a batch over the pool, writing the answers to out in the order of
+// the queries and the statistics of the batch to stderr.
+static void serveBatch(const std::vector<Query>& batch, const Engine& e, WorkPool* pool, FILE* out) {
+  std::vector<Answer> answers(batch.size());
+  auto start = std::chrono::steady_clock::now();
+  pool->run(batch.size(), [&](size_t i) {
+    answer(batch[i], e, &answers[i]);
+  });
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  std::vector<double> us;
+  for (size_t i = 0; i < answers.size(); i++) {
+    for (size_t k = 0; k < answers[i].nearest.size(); k++) {
+      RestDist key = answers[i].nearest[k];
+      fprintf(out, "%zu %zu %u %u %.*s\n", i, k + 1, (unsigned) restIndex(key), (unsigned) restDist(key),
+              (int) sizeof(e.recs[0].name), e.recs[restIndex(key)].name);
+    }
+    us.push_back(answers[i].us);
+  }
+  fprintf(out, "\n");
+  fflush(out);
+
+  fprintf(stderr, "%zu queries in %.1f ms on %d threads: %.0f queries/s, latency us p50 %.1f p90 %.1f p99 %.1f max %.1f\n",
+          batch.size(), seconds * 1000, pool->threads(), batch.size() / std::max(seconds, 1e-9),
+          percentile(us, 0.5), percentile(us, 0.9), percentile(us, 0.99), percentile(us, 1.0));
+}
+
+// Reads batches from in, answering each to out, until in ends.
+static void serve(FILE* in, FILE* out, const Engine& e, WorkPool* pool) {
+  std::vector<Query> batch;
+  char line[256];
+  int lineNo = 0;
+  while (true) {
+    bool more = fgets(line, sizeof(line), in) != NULL;
+    lineNo++;
+    bool blank = !more || strspn(line, " \t\r\n") == strlen(line);
+    if (blank) {
+      if (!batch.empty()) {
+        serveBatch(batch, e, pool, out);
+        batch.clear();
+      }
+      if (!more) {
+        return;
+      }
+      continue;
+    }
+    if (line[0] == '#') {
+      continue;
+    }
+
+    Query q;
+    if (parseQuery(line, &q)) {
+      batch.push_back(q);
+    } else {
+      fprintf(stderr, "line %d: not \"x y rating [n [metric [zoom]]]\"\n", lineNo);
+    }
+  }
+}
+
+// Serves the connections to a Unix socket at path one after another.
+static int serveSocket(const char* path, const Engine& e, WorkPool* pool) {
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (fd < 0 || strlen(path) >= sizeof(addr.sun_path)) {
+    fprintf(stderr, "cannot make a socket at %s\n", path);
+    return 2;
+  }
+  strcpy(addr.sun_path, path);
+  unlink(path);
+  if (bind(fd, (sockaddr*) &addr, sizeof(addr)) != 0 || listen(fd, 4) != 0) {
+    fprintf(stderr, "cannot listen on %s\n", path);
+    return 2;
+  }
+  fprintf(stderr, "serving on %s\n", path);
+  // a client that goes away before its answer must not stop the service
+  signal(SIGPIPE, SIG_IGN);
+
+  while (true) {
+    int conn = accept(fd, NULL, NULL);
+    if (conn < 0) {
+      continue;
+    }
+    FILE* in = fdopen(conn, "r");
+    FILE* out = fdopen(dup(conn), "w");
+    if (in != NULL && out != NULL) {
+      serve(in, out, e, pool);
+    }
+    if (in != NULL) fclose(in);
+    if (out != NULL) fclose(out);
+  }
+}
+
+int main(int argc, char** argv) {
+  int threads = 0;
+  int sortMode = QUICK_SORT;
+  int kernel = bestScanKernel();
+  const char* socketPath = NULL;
+  const char* cardPath = NULL;
+  for (int i = 1; i < argc; i++) {
+    std::string a = argv[i];
+    bool more = i + 1 < argc;
+    if (a == "--threads" && more) threads = atoi(argv[++i]);
+    else if (a == "--socket" && more) socketPath = argv[++i];
+    else if (a == "--sort" && more) {
+      std::string s = argv[++i];
+      sortMode = s == "insertion" ? INSERTION_SORT : (s == "both" ? BOTH_SORTS : QUICK_SORT);
+    } else if (a == "--kernel" && more) {
+      std::string k = argv[++i];
+      kernel = -1;
+      for (int n = 0; n < NUM_SCAN_KERNELS; n++) {
+        if (k == scanKernelNames[n]) {
+          kernel = n;
+        }
+      }
+      if (kernel < 0 || !scanKernelSupported(kernel)) {
+        fprintf(stderr, "no %s scan kernel on this CPU\n", k.c_str());
+        return 2;
+      }
+    } else if (cardPath == NULL && a[0] != '-') cardPath = argv[i];
+    else {
+      cardPath = NULL;
+      break;
+    }
+  }
+  if (cardPath == NULL) {
+    fprintf(stderr, "usage: %s [--threads N] [--socket PATH] [--sort quick|insertion|both]"
+            " [--kernel scalar|sse2|avx2] CARD\n", argv[0]);
+    return 2;
+  }
+
+  int fd = open(cardPath, O_RDONLY);
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st) != 0 || (size_t) st.st_size < RESTAURANT_BYTES) {
+    fprintf(stderr, "cannot read %d restaurants from %s\n", NUM_RESTAURANTS, cardPath);
+    return 2;
+  }
+  void* image = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  if (image == MAP_FAILED) {
+    fprintf(stderr, "cannot map %s\n", cardPath);
+    return 2;
+  }
+  close(fd);
+
+  // the list build prints the time of each sort
+  Serial.setOutput(NULL);
+  WorkPool pool(threads);
+  Engine e;
+  e.recs = (const restaurant*) image;
+  buildScanSet(&e.set, e.recs, NUM_RESTAURANTS);
+  e.kernel = kernel;
+  e.sortMode = sortMode;
+  if (socketPath != NULL) {
+    return serveSocket(socketPath, e, &pool);
+  }
+  serve(stdin, stdout, e, &pool);
+  return 0;
+}
@@ -0,0 +1,514 @@
+/*
+	Replays input recorded on the hardware (see ../inputlog.h) against the
+	whole sketch, built for the host with a card image for the raw reads, a
+	directory standing in for the files on the card, and a frame buffer for
+	the display. The run is on the simulated clock (see Arduino.h), charged
+	for the card and display by their stand-ins and for the work of the sort
+	engines and the list scan by this tool, so it takes the same time on any
+	machine and every figure it reports is exactly repeatable.
+
+	Each interaction the sketch starts (see ../iostats.h) is timed from the
+	input that set it off until the display is idle again: the map fully
+	drawn, and for the list, its first page shown. Start-up and the
+	interactions that drew nothing are counted but not timed. The metrics
+	are printed one "name value" per line, and can be saved as a baseline
+	that later runs are checked against, failing when any of them has grown
+	by more than the tolerance.
+
+	The input can also hold lines
+
+		snap <millis> <name>
+
+	written by hand, which capture the display at that time. With --golden
+	each capture is compared with <name>.ppm in the golden directory and the
+	run fails if any pixel differs, leaving <name>.actual.ppm and a
+	<name>.diff.ppm with the differing pixels in red beside the golden image.
+	With --update as well, the captures are written as the new golden images.
+
+	Usage:
+		replay [options] INPUT
+
+	Options:
+		--card FILE       card image starting at REST_START_BLOCK (required)
+		--sd DIR          directory holding the files of the card (default .)
+		--settle MS       time run after the last input (default 5000)
+		--save FILE       write the metrics to FILE as a baseline
+		--baseline FILE   fail if a metric is worse than in FILE
+		--tolerance PCT   growth allowed over the baseline (default 10)
+		--golden DIR      compare the snapshots with the golden images in DIR
+		--update          write the snapshots to DIR as the golden images
+		--serial          copy the serial output of the sketch to stderr
+		--faults GOOD,N   make the card unreliable: reads at a clock faster
+		                  than sckRateID GOOD are bad, and every Nth read
+		                  fails (see SD.h)
+
+	Exit status is 0 if the run is within the baseline and matches the golden
+	images, 1 if it regressed or did not match, and 2 if it could not be run.
+*/
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <MCUFRIEND_kbv.h>
+#include <SD.h>
+#include <TouchScreen.h>
+
+#include "iostats.h"
+#include "lcd_image.h"
+#include "restaurant.h"
+#include "scheduler.h"
+#include "sdcard.h"
+
+// the pins of the joystick, as wired in a2part2.cpp
+#define JOY_VERT_ANALOG  A9
+#define JOY_HORIZ_ANALOG A8
+#define JOY_SEL 53
+
+// Simulated time of the work done by the firmware between clock reads, in
+// nanoseconds, estimated for the Mega.
+#define COMPARE_NS     3000  // closer() on two RestDist
+#define SWAP_NS        2000  // swap() of two RestDist
+#define RESTAURANT_NS 20000  // getRestaurant() copying from the cache, and the distance to it
+
+// the sketch, built with its main() renamed
+extern Task tasks[];
+extern int numTasks;
+extern MCUFRIEND_kbv tft;
+extern Sd2Card card;
+extern lcd_image_job_t mapJob;
+extern bool menuShown;
+void setup();
+
+struct InputEvent {
+  uint32_t ms;
+  int v, h, sel, tx, ty, tz;
+};
+
+struct Snapshot {
+  uint32_t ms;
+  std::string name;
+};
+
+struct Interaction {
+  uint8_t op;
+  uint64_t start, done; // simulated nanoseconds
+  bool finished;
+  IoCounters io;
+  uint32_t pixels;
+};
+
+// Reads the "in" and "snap" lines of a serial capture, skipping everything
+// else.
+static bool readInput(const char* path, std::vector<InputEvent>& events,
+                      std::vector<Snapshot>& snaps) {
+  FILE* f = fopen(path, "r");
+  if (f == NULL) {
+    return false;
+  }
+
+  char line[256];
+  while (fgets(line, sizeof(line), f)) {
+    InputEvent e;
+    Snapshot s;
+    char name[128];
+    if (sscanf(line, "in %u %d %d %d %d %d %d",
+               &e.ms, &e.v, &e.h, &e.sel, &e.tx, &e.ty, &e.tz) == 7) {
+      events.push_back(e);
+    } else if (sscanf(line, "snap %u %127s", &s.ms, name) == 2) {
+      s.name = name;
+      snaps.push_back(s);
+    }
+  }
+  fclose(f);
+  return true;
+}
+
+// Charges the simulated clock for the sorting and scanning done since it
+// was last read.
+static void chargeWork() {
+  static uint32_t compares = 0, swaps = 0, gets = 0;
+  static uint16_t seq = 0;
+
+  // the I/O counters restart with each interaction
+  if (ioSeq != seq) {
+    seq = ioSeq;
+    gets = 0;
+  }
+  uint32_t nowGets = ioStats.cacheHits + ioStats.cacheMisses;
+
+  hostCharge((sortStats.compares - compares) * COMPARE_NS
+             + (sortStats.swaps - swaps) * SWAP_NS
+             + (nowGets - gets) * RESTAURANT_NS);
+  compares = sortStats.compares;
+  swaps = sortStats.swaps;
+  gets = nowGets;
+}
+
+static void applyInput(const InputEvent& e) {
+  hostAnalog[JOY_VERT_ANALOG] = e.v;
+  hostAnalog[JOY_HORIZ_ANALOG] = e.h;
+  hostDigital[JOY_SEL] = e.sel ? LOW : HIGH;
+  hostTouch = TSPoint(e.tx, e.ty, e.tz);
+}
+
+static double percentile(std::vector<double> v, double p) {
+  if (v.empty()) return 0;
+  std::sort(v.begin(), v.end());
+  return v[std::min(v.size() - 1, (size_t) (p * (v.size() - 1) + 0.5))];
+}
+
+// Writes an image of RGB triples as a binary PPM.
+static bool writePPM(const std::string& path, const std::vector<uint8_t>& rgb, int w, int h) {
+  FILE* f = fopen(path.c_str(), "wb");
+  if (f == NULL) {
+    return false;
+  }
+  fprintf(f, "P6\n%d %d\n255\n", w, h);
+  fwrite(rgb.data(), 1, rgb.size(), f);
+  return fclose(f) == 0;
+}
+
+static bool readPPM(const std::string& path, std::vector<uint8_t>& rgb, int& w, int& h) {
+  FILE* f = fopen(path.c_str(), "rb");
+  int maxval;
+  if (f == NULL) {
+    return false;
+  }
+  if (fscanf(f, "P6 %d %d %d", &w, &h, &maxval) != 3 || maxval != 255 || fgetc(f) == EOF) {
+    fclose(f);
+    return false;
+  }
+  rgb.resize((size_t) w * h * 3);
+  bool ok = fread(rgb.data(), 1, rgb.size(), f) == rgb.size();
+  fclose(f);
+  return ok;
+}
+
+// The display as RGB triples, each channel of the RGB565 pixels scaled up
+// to 8 bits.
+static std::vector<uint8_t> frameRGB() {
+  const uint16_t* fb = tft.frame();
+  std::vector<uint8_t> rgb;
+  for (int32_t i = 0; i < (int32_t) tft.width() * tft.height(); i++) {
+    uint16_t p = fb[i];
+    rgb.push_back(((p >> 11) & 0x1F) * 255 / 31);
+    rgb.push_back(((p >> 5) & 0x3F) * 255 / 63);
+    rgb.push_back((p & 0x1F) * 255 / 31);
+  }
+  return rgb;
+}
+
+// Captures the display and writes it as the golden image, or compares it
+// with the golden image. Returns false if it does not match.
+static bool checkSnapshot(const Snapshot& s, const std::string& dir, bool update) {
+  std::string base = dir + "/" + s.name;
+  std::vector<uint8_t> now = frameRGB(), golden;
+  int w = tft.width(), h = tft.height(), gw, gh;
+
+  if (update) {
+    if (!writePPM(base + ".ppm", now, w, h)) {
+      printf("SNAPSHOT %s cannot be written\n", s.name.c_str());
+      return false;
+    }
+    return true;
+  }
+
+  if (!readPPM(base + ".ppm", golden, gw, gh) || gw != w || gh != h) {
+    printf("SNAPSHOT %s has no golden image of %dx%d\n", s.name.c_str(), w, h);
+    writePPM(base + ".actual.ppm", now, w, h);
+    return false;
+  }
+
+  // the differing pixels in red over a dimmed copy of the golden image
+  std::vector<uint8_t> diff(now.size());
+  int differ = 0, x0 = w, y0 = h, x1 = -1, y1 = -1;
+  for (int y = 0; y < h; y++) {
+    for (int x = 0; x < w; x++) {
+      size_t i = ((size_t) y * w + x) * 3;
+      bool same = memcmp(&now[i], &golden[i], 3) == 0;
+      for (int c = 0; c < 3; c++) {
+        diff[i + c] = same ? golden[i + c] / 4 : (c == 0 ? 255 : 0);
+      }
+      if (!same) {
+        differ++;
+        x0 = min(x0, x);
+        y0 = min(y0, y);
+        x1 = max(x1, x);
+        y1 = max(y1, y);
+      }
+    }
+  }
+
+  if (differ == 0) {
+    return true;
+  }
+  printf("SNAPSHOT %s differs in %d pixels within (%d,%d)-(%d,%d)\n",
+         s.name.c_str(), differ, x0, y0, x1, y1);
+  writePPM(base + ".actual.ppm", now, w, h);
+  writePPM(base + ".diff.ppm", diff, w, h);
+  return false;
+}
+
+typedef std::map<std::string, double> Metrics;
+
+static Metrics summarise(const std::vector<Interaction>& inters) {
+  Metrics m;
+  std::vector<double> latency[NUM_IO_OPS];
+  IoCounters total = IoCounters();
+  uint32_t pixels = 0, incomplete = 0;
+
+  for (const Interaction& it : inters) {
+    std::string op = ioOpNames[it.op];
+    m[op + ".count"] += 1;
+    m[op + ".block_reads"] += it.io.blockReads;
+    m[op + ".sd_commands"] += it.io.sdCommands;
+    m[op + ".bytes_read"] += it.io.bytesRead;
+    m[op + ".tft_pixels"] += it.pixels;
+    // start-up, and interactions that drew nothing, have nothing to wait for
+    if (!it.finished) {
+      incomplete++;
+    } else if (it.op != IO_IDLE && it.pixels > 0) {
+      latency[it.op].push_back((it.done - it.start) / 1e6);
+    }
+
+    total.blockReads += it.io.blockReads;
+    total.sdCommands += it.io.sdCommands;
+    total.cacheMisses += it.io.cacheMisses;
+    total.fileOpens += it.io.fileOpens;
+    total.fileSeeks += it.io.fileSeeks;
+    total.bytesRead += it.io.bytesRead;
+    pixels += it.pixels;
+  }
+
+  for (int op = 0; op < NUM_IO_OPS; op++) {
+    if (!latency[op].empty()) {
+      std::string name = std::string(ioOpNames[op]) + ".latency_ms.";
+      m[name + "p50"] = percentile(latency[op], 0.5);
+      m[name + "p90"] = percentile(latency[op], 0.9);
+      m[name + "max"] = percentile(latency[op], 1.0);
+    }
+  }
+
+  m["total.block_reads"] = total.blockReads;
+  m["total.sd_commands"] = total.sdCommands;
+  // as the stand-in saw them, with those the SD library sends for files
+  m["total.card_commands"] = card.commands + SD.commands;
+  m["total.card_retries"] = cardErrors.retries;
+  m["total.card_failures"] = cardErrors.failures;
+  m["total.card_drops"] = cardErrors.drops;
+  m["total.card_rate"] = cardRate();
+  m["total.cache_misses"] = total.cacheMisses;
+  m["total.file_opens"] = total.fileOpens;
+  m["total.file_seeks"] = total.fileSeeks;
+  m["total.bytes_read"] = total.bytesRead;
+  m["total.tft_pixels"] = pixels;
+  m["total.sort_compares"] = sortStats.compares;
+  m["total.incomplete"] = incomplete;
+  return m;
+}
+
+static void writeMetrics(FILE* out, const Metrics& m) {
+  for (const auto& kv : m) {
+    fprintf(out, "%s %.1f\n", kv.first.c_str(), kv.second);
+  }
+}
+
+static bool readMetrics(const char* path, Metrics& m) {
+  FILE* f = fopen(path, "r");
+  if (f == NULL) {
+    return false;
+  }
+
+  char name[128];
+  double value;
+  while (fscanf(f, "%127s %lf", name, &value) == 2) {
+    m[name] = value;
+  }
+  fclose(f);
+  return true;
+}
+
+// Prints every metric that is worse than the baseline allows, returning
+// the number of them. The number of each kind of interaction must match,
+// or the run went differently and the rest cannot be compared.
+static int compareMetrics(const Metrics& now, const Metrics& base, double tolerance) {
+  int regressions = 0;
+  for (const auto& kv : base) {
+    const std::string& name = kv.first;
+    auto it = now.find(name);
+    double value = (it == now.end()) ? 0 : it->second;
+    bool isCount = name.size() > 6 && name.compare(name.size() - 6, 6, ".count") == 0;
+    double limit = isCount ? kv.second : kv.second * (1 + tolerance / 100) + 1;
+
+    if (value > limit || (isCount && value != kv.second)) {
+      printf("REGRESSION %s %.1f (baseline %.1f)\n", name.c_str(), value, kv.second);
+      regressions++;
+    }
+  }
+  for (const auto& kv : now) {
+    if (base.find(kv.first) == base.end() && kv.first.find(".count") != std::string::npos) {
+      printf("REGRESSION %s %.1f (not in baseline)\n", kv.first.c_str(), kv.second);
+      regressions++;
+    }
+  }
+  return regressions;
+}
+
+int main(int argc, char** argv) {
+  const char* cardPath = NULL;
+  const char* sdDir = ".";
+  const char* savePath = NULL;
+  const char* basePath = NULL;
+  const char* inputPath = NULL;
+  const char* goldenDir = NULL;
+  bool update = false;
+  double tolerance = 10;
+  uint32_t settle = 5000;
+  bool serial = false;
+
+  for (int i = 1; i < argc; i++) {
+    std::string a = argv[i];
+    bool more = i + 1 < argc;
+    if (a == "--card" && more) cardPath = argv[++i];
+    else if (a == "--sd" && more) sdDir = argv[++i];
+    else if (a == "--settle" && more) settle = atoi(argv[++i]);
+    else if (a == "--save" && more) savePath = argv[++i];
+    else if (a == "--baseline" && more) basePath = argv[++i];
+    else if (a == "--tolerance" && more) tolerance = atof(argv[++i]);
+    else if (a == "--golden" && more) goldenDir = argv[++i];
+    else if (a == "--update") update = true;
+    else if (a == "--serial") serial = true;
+    else if (a == "--faults" && more) {
+      unsigned good = 0, every = 0;
+      sscanf(argv[++i], "%u,%u", &good, &every);
+      card.setFaults(good, every);
+    }
+    else if (a[0] != '-' && inputPath == NULL) inputPath = argv[i];
+    else {
+      inputPath = NULL;
+      break;
+    }
+  }
+  if (cardPath == NULL || inputPath == NULL) {
+    fprintf(stderr, "usage: %s --card FILE [--sd DIR] [--settle MS] [--save FILE]"
+            " [--baseline FILE] [--tolerance PCT] [--golden DIR [--update]] [--serial]"
+            " [--faults GOOD,N] INPUT\n",
+            argv[0]);
+    return 2;
+  }
+
+  std::vector<InputEvent> events;
+  std::vector<Snapshot> snaps;
+  if (!readInput(inputPath, events, snaps)) {
+    fprintf(stderr, "cannot read input from %s\n", inputPath);
+    return 2;
+  }
+  if (!card.open(cardPath, REST_START_BLOCK)) {
+    fprintf(stderr, "cannot open card image %s\n", cardPath);
+    return 2;
+  }
+  Metrics base;
+  if (basePath && !readMetrics(basePath, base)) {
+    fprintf(stderr, "cannot read baseline from %s\n", basePath);
+    return 2;
+  }
+
+  SD.setRoot(sdDir);
+  Serial.setOutput(serial ? stderr : NULL);
+  hostUseSimulatedClock(chargeWork);
+
+  // everything up to the first interaction is charged to starting up
+  std::vector<Interaction> inters;
+  inters.push_back(Interaction());
+  uint16_t seq = ioSeq;
+  uint64_t lastInput = 0, answered = 0;
+
+  setup();
+
+  uint64_t last = events.empty() ? 0 : events.back().ms;
+  for (const Snapshot& s : snaps) {
+    last = max(last, s.ms);
+  }
+  uint64_t end = (last + settle) * 1000000ull;
+  size_t next = 0, nextSnap = 0;
+  int mismatches = 0;
+  uint64_t now;
+  while ((now = hostNanos()) < end) {
+    while (next < events.size() && events[next].ms * 1000000ull <= now) {
+      applyInput(events[next++]);
+      lastInput = now;
+    }
+
+    // the tasks are run one at a time, as runTasks() would run them, so
+    // the I/O of each one is charged to the interaction it was done for
+    for (int i = 0; i < numTasks; i++) {
+      uint32_t pixels = tft.pixelsWritten;
+      uint64_t began = now;
+      runTasks(&tasks[i], 1);
+      now = hostNanos();
+
+      if (ioSeq != seq) {
+        seq = ioSeq;
+        // timed from the input that set it off, if one has come since the
+        // last was answered. Otherwise the sketch set it off itself, as
+        // background work or on a timer (scrolling the list while the
+        // joystick is held), and it is timed from the task that began it.
+        bool byInput = lastInput > answered;
+        Interaction it = Interaction();
+        it.op = ioOp;
+        it.start = byInput ? lastInput : began;
+        inters.push_back(it);
+        if (byInput) {
+          answered = lastInput;
+        }
+      }
+
+      // drawing outside of any interaction, such as moving the highlight
+      // of the list, also answers the input
+      Interaction& it = inters.back();
+      uint32_t drawn = tft.pixelsWritten - pixels;
+      if (it.finished && drawn > 0) {
+        answered = now;
+      }
+      it.io = ioStats;
+      it.pixels += drawn;
+      if (!it.finished && !lcd_image_job_active(&mapJob) && (it.op != IO_LIST || menuShown)) {
+        it.finished = true;
+        it.done = now;
+      }
+    }
+
+    // snapshots are taken between passes, when no drawing is half done
+    while (nextSnap < snaps.size() && snaps[nextSnap].ms * 1000000ull <= now) {
+      if (goldenDir && !checkSnapshot(snaps[nextSnap], goldenDir, update)) {
+        mismatches++;
+      }
+      nextSnap++;
+    }
+  }
+
+  Metrics m = summarise(inters);
+  writeMetrics(stdout, m);
+
+  if (savePath) {
+    FILE* f = fopen(savePath, "w");
+    if (f == NULL) {
+      fprintf(stderr, "cannot write %s\n", savePath);
+      return 2;
+    }
+    writeMetrics(f, m);
+    fclose(f);
+  }
+
+  int regressions = 0;
+  if (basePath) {
+    regressions = compareMetrics(m, base, tolerance);
+    printf("%d regression%s against %s\n", regressions, regressions == 1 ? "" : "s", basePath);
+  }
+  if (goldenDir && !update) {
+    printf("%d of %zu snapshots differ from %s\n", mismatches, snaps.size(), goldenDir);
+  }
+  return (regressions || mismatches) ? 1 : 0;
+}
@@ -0,0 +1,188 @@
+#include "scankernel.h"
+
+#include <stdlib.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SCAN_X86
+#endif
+
+const char* const scanKernelNames[NUM_SCAN_KERNELS] = { "scalar", "sse2", "avx2" };
+
+void buildScanSet(ScanSet* set, const restaurant* recs, size_t n) {
+  set->n = n;
+  set->narrow = true;
+  set->stars.resize(n);
+  for (uint8_t zoom = 0; zoom < NUM_ZOOM_LEVELS; zoom++) {
+    set->x[zoom].resize(n);
+    set->y[zoom].resize(n);
+  }
+  for (size_t i = 0; i < n; i++) {
+    set->stars[i] = starRating(recs[i]);
+    for (uint8_t zoom = 0; zoom < NUM_ZOOM_LEVELS; zoom++) {
+      int16_t x = lon_to_x(recs[i].lon, zoom), y = lat_to_y(recs[i].lat, zoom);
+      set->x[zoom][i] = x;
+      set->y[zoom][i] = y;
+      set->narrow = set->narrow && abs(x) <= SCAN_NARROW && abs(y) <= SCAN_NARROW;
+    }
+  }
+}
+
+// The restaurants [first, n) of the set, as scanRestaurant() keys them.
+static size_t scanScalar(const ScanSet& set, size_t first, int16_t cx, int16_t cy, uint8_t zoom, int rating,
+                         RestDist keys[]) {
+  const int16_t* xs = set.x[zoom].data();
+  const int16_t* ys = set.y[zoom].data();
+  size_t out = 0;
+  for (size_t i = first; i < set.n; i++) {
+    if (set.stars[i] >= rating) {
+      keys[out++] = restKey(i, manhattan(xs[i], ys[i], cx, cy));
+    }
+  }
+  return out;
+}
+
+#ifdef SCAN_X86
+// Eight restaurants at a time: the lanes that pass the rating are picked
+// out of a copy of the distances one bit of the mask at a time.
+__attribute__((target("sse2")))
+static size_t scanSSE2(const ScanSet& set, int16_t cx, int16_t cy, uint8_t zoom, int rating, RestDist keys[]) {
+  const int16_t* xs = set.x[zoom].data();
+  const int16_t* ys = set.y[zoom].data();
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i vcx = _mm_set1_epi16(cx), vcy = _mm_set1_epi16(cy);
+  const __m128i below = _mm_set1_epi16(rating - 1);
+  const __m128i longest = _mm_set1_epi16((int16_t) REST_DIST_MAX);
+
+  size_t out = 0, i = 0;
+  uint16_t dist[8];
+  for (; i + 8 <= set.n; i += 8) {
+    __m128i pass = _mm_cmpgt_epi16(_mm_loadu_si128((const __m128i*) &set.stars[i]), below);
+    unsigned mask = _mm_movemask_epi8(_mm_packs_epi16(pass, zero));
+    if (mask == 0) {
+      continue;
+    }
+
+    __m128i dx = _mm_sub_epi16(_mm_loadu_si128((const __m128i*) &xs[i]), vcx);
+    __m128i dy = _mm_sub_epi16(_mm_loadu_si128((const __m128i*) &ys[i]), vcy);
+    dx = _mm_max_epi16(dx, _mm_sub_epi16(zero, dx));
+    dy = _mm_max_epi16(dy, _mm_sub_epi16(zero, dy));
+    __m128i d = _mm_add_epi16(dx, dy);
+    // the unsigned minimum of d and longest, which SSE2 has no instruction for
+    d = _mm_sub_epi16(d, _mm_subs_epu16(d, longest));
+    _mm_storeu_si128((__m128i*) dist, d);
+
+    for (; mask != 0; mask &= mask - 1) {
+      unsigned j = __builtin_ctz(mask);
+      keys[out++] = ((RestDist) dist[j] << REST_INDEX_BITS) | (i + j);
+    }
+  }
+  return out + scanScalar(set, i, cx, cy, zoom, rating, keys + out);
+}
+
+// For each mask of eight lanes, the lanes it has set in order, so that a
+// permute moves them to the front.
+struct CompactTable {
+  int32_t lanes[256][8];
+
+  CompactTable() {
+    for (int mask = 0; mask < 256; mask++) {
+      int k = 0;
+      for (int j = 0; j < 8; j++) {
+        if (mask & (1 << j)) {
+          lanes[mask][k++] = j;
+        }
+      }
+      while (k < 8) {
+        lanes[mask][k++] = 0;
+      }
+    }
+  }
+};
+
+static const CompactTable compact;
+
+// Sixteen restaurants at a time: the keys of each half are made in 32 bit
+// lanes and those that pass the rating permuted to the front and stored
+// together. A store writes all eight lanes, but never past the keys of the
+// sixteen, so it stays within keys.
+__attribute__((target("avx2,popcnt")))
+static size_t scanAVX2(const ScanSet& set, int16_t cx, int16_t cy, uint8_t zoom, int rating, RestDist keys[]) {
+  static_assert(sizeof(RestDist) == 4, "the AVX2 kernel stores keys in 32 bit lanes");
+
+  const int16_t* xs = set.x[zoom].data();
+  const int16_t* ys = set.y[zoom].data();
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i vcx = _mm256_set1_epi16(cx), vcy = _mm256_set1_epi16(cy);
+  const __m256i below = _mm256_set1_epi16(rating - 1);
+  const __m256i longest = _mm256_set1_epi16((int16_t) REST_DIST_MAX);
+  const __m256i lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+
+  size_t out = 0, i = 0;
+  for (; i + 16 <= set.n; i += 16) {
+    __m256i pass = _mm256_cmpgt_epi16(_mm256_loadu_si256((const __m256i*) &set.stars[i]), below);
+    // the mask of lanes 0-7 in bits 0-7, and of lanes 8-15 in bits 16-23
+    unsigned mask = _mm256_movemask_epi8(_mm256_packs_epi16(pass, zero));
+    if (mask == 0) {
+      continue;
+    }
+
+    __m256i dx = _mm256_abs_epi16(_mm256_sub_epi16(_mm256_loadu_si256((const __m256i*) &xs[i]), vcx));
+    __m256i dy = _mm256_abs_epi16(_mm256_sub_epi16(_mm256_loadu_si256((const __m256i*) &ys[i]), vcy));
+    __m256i d = _mm256_min_epu16(_mm256_add_epi16(dx, dy), longest);
+
+    __m256i index = _mm256_add_epi32(_mm256_set1_epi32(i), lane);
+    __m256i lo = _mm256_cvtepu16_epi32(_mm256_castsi256_si128(d));
+    __m256i hi = _mm256_cvtepu16_epi32(_mm256_extracti128_si256(d, 1));
+    lo = _mm256_or_si256(_mm256_slli_epi32(lo, REST_INDEX_BITS), index);
+    hi = _mm256_or_si256(_mm256_slli_epi32(hi, REST_INDEX_BITS), _mm256_add_epi32(index, _mm256_set1_epi32(8)));
+
+    unsigned mlo = mask & 0xFF, mhi = (mask >> 16) & 0xFF;
+    __m256i pick = _mm256_loadu_si256((const __m256i*) compact.lanes[mlo]);
+    _mm256_storeu_si256((__m256i*) &keys[out], _mm256_permutevar8x32_epi32(lo, pick));
+    out += __builtin_popcount(mlo);
+    pick = _mm256_loadu_si256((const __m256i*) compact.lanes[mhi]);
+    _mm256_storeu_si256((__m256i*) &keys[out], _mm256_permutevar8x32_epi32(hi, pick));
+    out += __builtin_popcount(mhi);
+  }
+  return out + scanScalar(set, i, cx, cy, zoom, rating, keys + out);
+}
+#endif
+
+bool scanKernelSupported(int kernel) {
+  switch (kernel) {
+    case SCAN_SCALAR:
+      return true;
+#ifdef SCAN_X86
+    case SCAN_SSE2:
+      return __builtin_cpu_supports("sse2");
+    case SCAN_AVX2:
+      return __builtin_cpu_supports("avx2");
+#endif
+    default:
+      return false;
+  }
+}
+
+int bestScanKernel() {
+  for (int kernel = NUM_SCAN_KERNELS - 1; kernel > SCAN_SCALAR; kernel--) {
+    if (scanKernelSupported(kernel)) {
+      return kernel;
+    }
+  }
+  return SCAN_SCALAR;
+}
+
+size_t scanManhattan(int kernel, const ScanSet& set, int16_t cx, int16_t cy, uint8_t zoom, int rating,
+                     RestDist keys[]) {
+#ifdef SCAN_X86
+  bool narrow = set.narrow && abs(cx) <= SCAN_NARROW && abs(cy) <= SCAN_NARROW;
+  if (narrow && kernel == SCAN_AVX2) {
+    return scanAVX2(set, cx, cy, zoom, rating, keys);
+  }
+  if (narrow && kernel == SCAN_SSE2) {
+    return scanSSE2(set, cx, cy, zoom, rating, keys);
+  }
+#endif
+  return scanScalar(set, 0, cx, cy, zoom, rating, keys);
+}
@@ -0,0 +1,61 @@
+/*
+	Kernels for the scan of the list build (see ../restaurant.h) on the
+	host, for the query service and the benchmarks over large synthetic
+	datasets. The scan keeps the restaurants of at least a rating and keys
+	each by its Manhattan distance to the cursor, as scanRestaurant() does.
+
+	The kernels read the restaurants as a struct of arrays: the pixel
+	coordinates at each zoom level and the star rating, each in an array of
+	its own, worked out once rather than for every query. The SSE2 kernel
+	takes 8 restaurants and the AVX2 kernel 16 at a time in 16 bit lanes,
+	computing |dx| + |dy| and the rating mask together, then compacts the
+	keys of the restaurants that pass into the list. The kernel is picked
+	at run time from those the CPU has, with a scalar kernel for any other.
+
+	Every kernel writes the same keys in the same order as the scalar one.
+	The 16 bit lanes hold the distances exactly only while the coordinates
+	are within SCAN_NARROW of the origin, which any point of the map is, so
+	for a set or cursor beyond that the scalar kernel is used.
+*/
+
+#ifndef _HOST_SCANKERNEL_H_
+#define _HOST_SCANKERNEL_H_
+
+#include <stddef.h>
+#include <vector>
+
+#include "restaurant.h"
+
+// Largest coordinate, either way, the vector kernels take, so that neither
+// dx nor dy nor their sum overflows a 16 bit lane.
+#define SCAN_NARROW 16383
+
+enum ScanKernel { SCAN_SCALAR, SCAN_SSE2, SCAN_AVX2, NUM_SCAN_KERNELS };
+
+extern const char* const scanKernelNames[NUM_SCAN_KERNELS];
+
+// The restaurants as the kernels read them.
+struct ScanSet {
+  size_t n;
+  std::vector<int16_t> x[NUM_ZOOM_LEVELS], y[NUM_ZOOM_LEVELS];
+  std::vector<int16_t> stars;
+  bool narrow; // every coordinate is within SCAN_NARROW
+};
+
+// Lays out n restaurants, at most REST_INDEX_MASK + 1, for the kernels.
+void buildScanSet(ScanSet* set, const restaurant* recs, size_t n);
+
+// Returns true if the CPU runs the kernel.
+bool scanKernelSupported(int kernel);
+
+// The fastest kernel the CPU runs.
+int bestScanKernel();
+
+// Writes the keys of the restaurants of the set of at least the rating to
+// keys, in the order of the set, by their Manhattan distance to the cursor
+// (cx, cy) in pixels of the zoom level, and returns how many it wrote.
+// keys has room for set.n keys. The kernel must be supported.
+size_t scanManhattan(int kernel, const ScanSet& set, int16_t cx, int16_t cy, uint8_t zoom, int rating,
+                     RestDist keys[]);
+
+#endif
@@ -0,0 +1,343 @@
+/*
+	Host benchmark of the restaurant sort engines over cursor workloads.
+
+	Every cursor position of the workload is run through each engine on a
+	fresh copy of the unsorted list for that position, on the real dataset
+	(from a card image) or a synthetic one of the same size, and on synthetic
+	datasets scaled up from it. One JSON object is printed per dataset and
+	engine with the latency distribution in microseconds, the mean number of
+	comparisons and swaps, and the peak quicksort depth.
+
+	Usage:
+		sortbench [options]
+
+	Options:
+		--card FILE     card image starting at REST_START_BLOCK (default: synthetic data)
+		--cursors FILE  cursor positions, one "x y" pair of full size map pixels per line
+		--walk N        N positions of a random walk around the map (default 200)
+		--uniform N     N positions uniformly over the map
+		--scale K       also run on a synthetic dataset K times as large (repeatable)
+		--rating R      minimum star rating of the restaurants listed (default 1)
+		--seed S        seed for the synthetic data and workloads (default 1)
+		--raw           also print one JSON object per query
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "restaurant.h"
+
+// insertion sort is quadratic, so it is skipped on lists longer than this
+#define MAX_INSERTION_SORT 20000
+
+struct Point {
+  int16_t x, y;
+  uint8_t rating;
+};
+
+struct Sample {
+  double us, firstPageUs;
+  uint32_t compares, swaps;
+  uint16_t depth;
+};
+
+static bool raw = false;
+
+// The list build is stepped one unit of work (one restaurant scanned, one
+// selected, one sort step) at a time to time its first page, so this stands
+// in for the scheduler's time budgets.
+static int unitsLeft = 0;
+
+bool withinBudget(uint32_t, uint16_t budget) {
+  return budget == NO_BUDGET || unitsLeft-- > 0;
+}
+
+static double elapsedUs(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+}
+
+static void resetStats() {
+  memset(&sortStats, 0, sizeof(sortStats));
+}
+
+static Sample takeStats(double us) {
+  Sample s = { us, 0, sortStats.compares, sortStats.swaps, sortStats.maxDepth };
+  return s;
+}
+
+// Synthetic restaurants: about half clustered around downtown, the rest
+// spread uniformly over the map, with ratings uniform over 0 to 10.
+static std::vector<Point> syntheticPoints(size_t n, unsigned seed) {
+  std::vector<Point> pts(n);
+  srand(seed);
+  for (size_t i = 0; i < n; i++) {
+    if (rand() % 2) {
+      int dx = 0, dy = 0;
+      for (int k = 0; k < 4; k++) {
+        dx += rand() % 161 - 80;
+        dy += rand() % 161 - 80;
+      }
+      pts[i].x = constrain(1100 + dx, 0, MAPWIDTH - 1);
+      pts[i].y = constrain(1000 + dy, 0, MAPHEIGHT - 1);
+    } else {
+      pts[i].x = rand() % MAPWIDTH;
+      pts[i].y = rand() % MAPHEIGHT;
+    }
+    pts[i].rating = rand() % 11;
+  }
+  return pts;
+}
+
+// A card image in memory holding the points as restaurant records.
+static std::vector<uint8_t> syntheticCard(const std::vector<Point>& pts) {
+  std::vector<uint8_t> image((pts.size() + 7) / 8 * 512);
+  restaurant* recs = (restaurant*) image.data();
+  for (size_t i = 0; i < pts.size(); i++) {
+    recs[i].lon = x_to_lon(pts[i].x);
+    recs[i].lat = y_to_lat(pts[i].y);
+    recs[i].rating = pts[i].rating;
+    snprintf(recs[i].name, sizeof(recs[i].name), "Synthetic %u", (unsigned) i);
+  }
+  return image;
+}
+
+static std::vector<Point> cardPoints(Sd2Card* card) {
+  std::vector<Point> pts(NUM_RESTAURANTS);
+  RestCache cache;
+  cache.cachedBlock = 0;
+  for (int i = 0; i < NUM_RESTAURANTS; i++) {
+    restaurant r;
+    getRestaurant(&r, i, card, &cache);
+    pts[i].x = lon_to_x(r.lon);
+    pts[i].y = lat_to_y(r.lat);
+    pts[i].rating = r.rating;
+  }
+  return pts;
+}
+
+// The unsorted list for a cursor, in the same order the scan produces it.
+static int buildList(const std::vector<Point>& pts, int x, int y, int rating, RestDist list[]) {
+  int n = 0;
+  for (size_t i = 0; i < pts.size(); i++) {
+    if (max((pts[i].rating + 1) / 2, 1) < rating) {
+      continue;
+    }
+    list[n] = restKey(i, min(abs(pts[i].x - x) + abs(pts[i].y - y), (int) REST_DIST_MAX));
+    n++;
+  }
+  return n;
+}
+
+static double percentile(std::vector<double> v, double p) {
+  if (v.empty()) return 0;
+  std::sort(v.begin(), v.end());
+  size_t i = std::min(v.size() - 1, (size_t) (p * (v.size() - 1) + 0.5));
+  return v[i];
+}
+
+static void printDistribution(const char* name, const std::vector<double>& v) {
+  double sum = 0;
+  for (double x : v) sum += x;
+  printf("\"%s\":{\"mean\":%.1f,\"p50\":%.1f,\"p90\":%.1f,\"p99\":%.1f,\"max\":%.1f}",
+         name, v.empty() ? 0 : sum / v.size(), percentile(v, 0.5), percentile(v, 0.9),
+         percentile(v, 0.99), percentile(v, 1.0));
+}
+
+static void report(const std::string& dataset, size_t n, const char* engine,
+                   const std::vector<Sample>& samples, bool hasFirstPage) {
+  std::vector<double> us, first;
+  double compares = 0, swaps = 0;
+  uint16_t depth = 0;
+  for (const Sample& s : samples) {
+    us.push_back(s.us);
+    first.push_back(s.firstPageUs);
+    compares += s.compares;
+    swaps += s.swaps;
+    depth = max(depth, s.depth);
+  }
+
+  printf("{\"dataset\":\"%s\",\"restaurants\":%zu,\"engine\":\"%s\",\"queries\":%zu,",
+         dataset.c_str(), n, engine, samples.size());
+  printDistribution("latency_us", us);
+  if (hasFirstPage) {
+    printf(",");
+    printDistribution("first_page_us", first);
+  }
+  printf(",\"compares\":%.1f,\"swaps\":%.1f,\"max_depth\":%u}\n",
+         compares / samples.size(), swaps / samples.size(), depth);
+}
+
+static void rawSample(const std::string& dataset, const char* engine, size_t q,
+                      int x, int y, int n, const Sample& s) {
+  if (raw) {
+    printf("{\"dataset\":\"%s\",\"engine\":\"%s\",\"query\":%zu,\"x\":%d,\"y\":%d,\"listed\":%d,"
+           "\"us\":%.1f,\"compares\":%u,\"swaps\":%u,\"depth\":%u}\n",
+           dataset.c_str(), engine, q, x, y, n, s.us, s.compares, s.swaps, s.depth);
+  }
+}
+
+// Runs the plain sort engines on the lists built from the points.
+static void benchEngines(const std::string& dataset, const std::vector<Point>& pts,
+                         const std::vector<std::pair<int, int> >& cursors, int rating) {
+  std::vector<RestDist> unsorted(pts.size()), list(pts.size());
+  std::vector<Sample> quick, insertion;
+
+  for (size_t q = 0; q < cursors.size(); q++) {
+    int n = buildList(pts, cursors[q].first, cursors[q].second, rating, unsorted.data());
+
+    list = unsorted;
+    resetStats();
+    auto start = std::chrono::steady_clock::now();
+    quickSort(list.data(), 0, n - 1);
+    quick.push_back(takeStats(elapsedUs(start)));
+    rawSample(dataset, "quicksort", q, cursors[q].first, cursors[q].second, n, quick.back());
+
+    if (n <= MAX_INSERTION_SORT) {
+      list = unsorted;
+      resetStats();
+      start = std::chrono::steady_clock::now();
+      insertionSort(list.data(), n);
+      insertion.push_back(takeStats(elapsedUs(start)));
+      rawSample(dataset, "insertion", q, cursors[q].first, cursors[q].second, n, insertion.back());
+    }
+  }
+
+  report(dataset, pts.size(), "quicksort", quick, false);
+  if (!insertion.empty()) {
+    report(dataset, pts.size(), "insertion", insertion, false);
+  }
+}
+
+// Runs the resumable list build the firmware uses, card reads included.
+static void benchListBuild(const std::string& dataset, Sd2Card* card,
+                           const std::vector<std::pair<int, int> >& cursors, int rating) {
+  static RestDist list[NUM_RESTAURANTS];
+  const int modes[] = { QUICK_SORT, INSERTION_SORT };
+  const char* names[] = { "list-quicksort", "list-insertion" };
+
+  Serial.setOutput(NULL);
+  for (int m = 0; m < 2; m++) {
+    std::vector<Sample> samples;
+    for (size_t q = 0; q < cursors.size(); q++) {
+      MapView mv = { 0, 0, (int16_t) cursors[q].first, (int16_t) cursors[q].second, 0 };
+      RestCache cache;
+      ListBuild lb;
+      cache.cachedBlock = 0;
+
+      resetStats();
+      auto start = std::chrono::steady_clock::now();
+      double firstPage = -1;
+      startList(&lb, mv, rating, modes[m]);
+      // step one unit of work at a time to catch the first page
+      for (unitsLeft = 1; !stepList(&lb, list, card, &cache, 1); unitsLeft = 1) {
+        if (firstPage < 0 && listReady(&lb, REST_PAGE_SIZE)) {
+          firstPage = elapsedUs(start);
+        }
+      }
+      Sample s = takeStats(elapsedUs(start));
+      s.firstPageUs = firstPage < 0 ? s.us : firstPage;
+      samples.push_back(s);
+      rawSample(dataset, names[m], q, cursors[q].first, cursors[q].second, lb.count, s);
+    }
+    report(dataset, NUM_RESTAURANTS, names[m], samples, true);
+  }
+  Serial.setOutput(stdout);
+}
+
+static bool readCursors(const char* path, std::vector<std::pair<int, int> >& cursors) {
+  FILE* f = fopen(path, "r");
+  if (!f) return false;
+  char line[128];
+  while (fgets(line, sizeof(line), f)) {
+    int x, y;
+    if (line[0] != '#' && sscanf(line, "%d %d", &x, &y) == 2) {
+      cursors.push_back(std::make_pair(x, y));
+    }
+  }
+  fclose(f);
+  return true;
+}
+
+// A user panning around: steps of up to 40 pixels, kept on the map.
+static void walkCursors(int n, std::vector<std::pair<int, int> >& cursors) {
+  int x = MAPWIDTH / 2, y = MAPHEIGHT / 2;
+  for (int i = 0; i < n; i++) {
+    x = constrain(x + rand() % 81 - 40, 0, MAPWIDTH - 1);
+    y = constrain(y + rand() % 81 - 40, 0, MAPHEIGHT - 1);
+    cursors.push_back(std::make_pair(x, y));
+  }
+}
+
+static void uniformCursors(int n, std::vector<std::pair<int, int> >& cursors) {
+  for (int i = 0; i < n; i++) {
+    cursors.push_back(std::make_pair(rand() % MAPWIDTH, rand() % MAPHEIGHT));
+  }
+}
+
+int main(int argc, char** argv) {
+  const char* cardPath = NULL;
+  std::vector<std::pair<int, int> > cursors;
+  std::vector<int> scales;
+  int rating = 1, walk = 0, uniform = 0;
+  unsigned seed = 1;
+  const char* cursorPath = NULL;
+
+  for (int i = 1; i < argc; i++) {
+    std::string a = argv[i];
+    bool more = i + 1 < argc;
+    if (a == "--card" && more) cardPath = argv[++i];
+    else if (a == "--cursors" && more) cursorPath = argv[++i];
+    else if (a == "--walk" && more) walk = atoi(argv[++i]);
+    else if (a == "--uniform" && more) uniform = atoi(argv[++i]);
+    else if (a == "--scale" && more) scales.push_back(atoi(argv[++i]));
+    else if (a == "--rating" && more) rating = atoi(argv[++i]);
+    else if (a == "--seed" && more) seed = atoi(argv[++i]);
+    else if (a == "--raw") raw = true;
+    else {
+      fprintf(stderr, "usage: %s [--card FILE] [--cursors FILE] [--walk N] [--uniform N]"
+              " [--scale K]... [--rating R] [--seed S] [--raw]\n", argv[0]);
+      return 2;
+    }
+  }
+
+  srand(seed);
+  if (cursorPath && !readCursors(cursorPath, cursors)) {
+    fprintf(stderr, "cannot read cursors from %s\n", cursorPath);
+    return 1;
+  }
+  walkCursors(walk, cursors);
+  uniformCursors(uniform, cursors);
+  if (cursors.empty()) {
+    walkCursors(200, cursors);
+  }
+
+  Sd2Card card;
+  std::vector<uint8_t> image;
+  std::vector<Point> pts;
+  std::string dataset;
+  if (cardPath) {
+    if (!card.open(cardPath, REST_START_BLOCK)) {
+      fprintf(stderr, "cannot open card image %s\n", cardPath);
+      return 1;
+    }
+    pts = cardPoints(&card);
+    dataset = "card";
+  } else {
+    pts = syntheticPoints(NUM_RESTAURANTS, seed);
+    image = syntheticCard(pts);
+    card.openMemory(image.data(), image.size() / 512, REST_START_BLOCK);
+    dataset = "synthetic";
+  }
+
+  benchEngines(dataset, pts, cursors, rating);
+  benchListBuild(dataset, &card, cursors, rating);
+
+  for (int k : scales) {
+    benchEngines(dataset + "x" + std::to_string(k), syntheticPoints(pts.size() * k, seed + k),
+                 cursors, rating);
+  }
+
+  return 0;
+}
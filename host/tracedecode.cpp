@@ -0,0 +1,93 @@
+/*
+	Decodes a binary trace captured from the serial port of firmware built
+	with TRACE (see ../trace.h) and prints a histogram of the durations of
+	each traced stage. Text printed over serial between trace records is
+	skipped.
+
+	Usage:
+		tracedecode [FILE]   (reads standard input without a file)
+*/
+
+#include <algorithm>
+#include <vector>
+
+#include "trace.h"
+
+static uint32_t le32(const uint8_t* p) {
+  return p[0] | (p[1] << 8) | ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+static uint32_t percentile(const std::vector<uint32_t>& v, double p) {
+  return v[std::min(v.size() - 1, (size_t) (p * (v.size() - 1) + 0.5))];
+}
+
+int main(int argc, char** argv) {
+  FILE* in = (argc > 1) ? fopen(argv[1], "rb") : stdin;
+  if (in == NULL) {
+    fprintf(stderr, "cannot open %s\n", argv[1]);
+    return 1;
+  }
+
+  std::vector<uint8_t> data;
+  uint8_t buf[4096];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), in)) > 0) {
+    data.insert(data.end(), buf, buf + n);
+  }
+
+  std::vector<uint32_t> durations[NUM_TRACE_STAGES];
+  uint64_t dropped = 0, skipped = 0;
+
+  for (size_t i = 0; i < data.size(); ) {
+    uint8_t stage = (i + 1 < data.size()) ? data[i + 1] : 0;
+    bool valid = data[i] == TRACE_SYNC && i + TRACE_RECORD_BYTES <= data.size()
+      && (stage < NUM_TRACE_STAGES || stage == TRACE_DROPPED);
+    if (!valid) {
+      skipped++;
+      i++;
+      continue;
+    }
+
+    uint32_t duration = le32(&data[i + 6]);
+    if (stage == TRACE_DROPPED) {
+      dropped += duration;
+    } else {
+      durations[stage].push_back(duration);
+    }
+    i += TRACE_RECORD_BYTES;
+  }
+
+  printf("%llu bytes of other output skipped, %llu records dropped on the device\n",
+         (unsigned long long) skipped, (unsigned long long) dropped);
+
+  for (int s = 0; s < NUM_TRACE_STAGES; s++) {
+    std::vector<uint32_t>& v = durations[s];
+    if (v.empty()) {
+      continue;
+    }
+    std::sort(v.begin(), v.end());
+
+    uint64_t total = 0;
+    for (uint32_t d : v) total += d;
+    printf("\n%s: %zu records, total %llu us, min %u, p50 %u, p90 %u, p99 %u, max %u us\n",
+           traceStageNames[s], v.size(), (unsigned long long) total,
+           v.front(), percentile(v, 0.5), percentile(v, 0.9), percentile(v, 0.99), v.back());
+
+    // power of two buckets, with bars scaled to the largest bucket
+    size_t buckets[33] = { 0 }, most = 0;
+    for (uint32_t d : v) {
+      int b = 0;
+      while (b < 32 && (1ull << b) <= d) b++;
+      most = std::max(most, ++buckets[b]);
+    }
+    for (int b = 0; b < 33; b++) {
+      if (buckets[b] == 0) continue;
+      unsigned long long lo = b ? (1ull << (b - 1)) : 0, hi = 1ull << b;
+      printf("  %10llu - %-10llu us %8zu ", lo, hi, buckets[b]);
+      for (size_t k = 0; k < (buckets[b] * 40 + most - 1) / most; k++) putchar('#');
+      putchar('\n');
+    }
+  }
+
+  return 0;
+}
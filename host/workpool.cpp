@@ -0,0 +1,79 @@
+#include "workpool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// The tasks a thread has left: it takes them from the front, and other
+// threads steal them from the back.
+struct Queue {
+  std::mutex lock;
+  std::deque<size_t> tasks;
+};
+
+WorkPool::WorkPool(int threads) : numThreads(threads), numSteals(0) {
+  if (numThreads <= 0) {
+    numThreads = std::max(1u, std::thread::hardware_concurrency());
+  }
+}
+
+// The next task for thread self: its own next one, or one stolen from the
+// back of the first other queue that has any. Returns false once every
+// queue is empty.
+static bool nextTask(std::vector<Queue>& queues, size_t self, size_t* task, std::atomic<size_t>& steals) {
+  {
+    std::lock_guard<std::mutex> hold(queues[self].lock);
+    if (!queues[self].tasks.empty()) {
+      *task = queues[self].tasks.front();
+      queues[self].tasks.pop_front();
+      return true;
+    }
+  }
+
+  for (size_t k = 1; k < queues.size(); k++) {
+    Queue& victim = queues[(self + k) % queues.size()];
+    std::lock_guard<std::mutex> hold(victim.lock);
+    if (!victim.tasks.empty()) {
+      *task = victim.tasks.back();
+      victim.tasks.pop_back();
+      steals++;
+      return true;
+    }
+  }
+  return false;
+}
+
+void WorkPool::run(size_t n, const std::function<void(size_t)>& task) {
+  size_t threads = std::min((size_t) numThreads, n);
+  if (threads <= 1) {
+    for (size_t i = 0; i < n; i++) {
+      task(i);
+    }
+    return;
+  }
+
+  std::vector<Queue> queues(threads);
+  for (size_t t = 0; t < threads; t++) {
+    for (size_t i = n * t / threads; i < n * (t + 1) / threads; i++) {
+      queues[t].tasks.push_back(i);
+    }
+  }
+
+  std::atomic<size_t> steals(0);
+  std::vector<std::thread> workers;
+  for (size_t t = 0; t < threads; t++) {
+    workers.emplace_back([&, t]() {
+      size_t i;
+      while (nextTask(queues, t, &i, steals)) {
+        task(i);
+      }
+    });
+  }
+  for (std::thread& w : workers) {
+    w.join();
+  }
+  numSteals += steals;
+}
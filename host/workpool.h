@@ -0,0 +1,37 @@
+/*
+	A pool of threads for the host tools that build the contents of the
+	card. A job is a number of independent tasks, numbered from 0. Each
+	thread starts on an equal run of consecutive tasks and, once it has run
+	out, steals the last task of the run of another thread, so threads that
+	draw cheap tasks help those that draw expensive ones.
+
+	Tasks must only write results of their own (a slot of the output picked
+	by the task number), so the output is the same for any number of
+	threads.
+*/
+
+#ifndef _HOST_WORKPOOL_H_
+#define _HOST_WORKPOOL_H_
+
+#include <stddef.h>
+#include <functional>
+
+class WorkPool {
+public:
+  // A pool of the given number of threads, or one per core if 0.
+  explicit WorkPool(int threads = 0);
+
+  int threads() const { return numThreads; }
+
+  // Runs task(i) for each i in [0, n), returning once all have run.
+  void run(size_t n, const std::function<void(size_t)>& task);
+
+  // Number of tasks stolen from another thread since the pool was made.
+  size_t steals() const { return numSteals; }
+
+private:
+  int numThreads;
+  size_t numSteals;
+};
+
+#endif
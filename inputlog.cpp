@@ -0,0 +1,63 @@
+#include "inputlog.h"
+
+#ifdef RECORD_INPUT
+
+// the input as last recorded, starting from the joystick at rest
+static int lastV = -1, lastH = -1, lastTx, lastTy, lastTz;
+static bool lastSel;
+
+/*
+	Checks if a reading has moved further than its noise from the reading
+	last recorded.
+
+	Arguments:
+		now (int): the reading
+		last (int): the reading last recorded
+		noise (int): largest change that is noise
+
+	Returns:
+		true if the reading has changed
+*/
+static bool changed(int now, int last, int noise) {
+	return abs(now - last) > noise;
+}
+
+/*
+	Writes the input over serial as an "in" line if it has changed by more
+	than noise since it was last written.
+
+	Arguments:
+		v, h (int): readings of the vertical and horizontal joystick axes
+		sel (bool): true if the joystick button is held
+		tx, ty, tz (int): raw reading of the touchscreen, all 0 if not pressed
+
+	Returns:
+		None
+*/
+void recordInput(int v, int h, bool sel, int tx, int ty, int tz) {
+	bool touched = (tz != 0);
+	if (!changed(v, lastV, INPUT_LOG_JOY_NOISE) && !changed(h, lastH, INPUT_LOG_JOY_NOISE)
+			&& sel == lastSel && touched == (lastTz != 0)
+			&& !changed(tx, lastTx, INPUT_LOG_TOUCH_NOISE)
+			&& !changed(ty, lastTy, INPUT_LOG_TOUCH_NOISE)) {
+		return;
+	}
+
+	lastV = v;
+	lastH = h;
+	lastSel = sel;
+	lastTx = tx;
+	lastTy = ty;
+	lastTz = tz;
+
+	Serial.print("in ");
+	Serial.print(millis());
+	int fields[] = { v, h, sel, tx, ty, tz };
+	for (int i = 0; i < 6; i++) {
+		Serial.print(' ');
+		Serial.print(fields[i]);
+	}
+	Serial.println();
+}
+
+#endif
@@ -0,0 +1,41 @@
+/*
+	Recording of the raw input sampled by the main loop, so that a session on
+	the hardware can be replayed on the host by host/replay. Every change of
+	the input beyond the noise of the readings goes over serial as a line
+
+		in <millis> <vert> <horiz> <sel> <touch x> <touch y> <touch z>
+
+	among the rest of the serial output, with sel 1 while the joystick button
+	is held and the touch all zero while the screen is not pressed.
+
+	Recording is compiled in with -DRECORD_INPUT (make RECORD_INPUT=1), which
+	also raises the serial rate to INPUT_LOG_BAUD so the lines keep up with
+	the joystick, and costs nothing otherwise.
+*/
+
+#ifndef _INPUTLOG_H_
+#define _INPUTLOG_H_
+
+#include <Arduino.h>
+
+#define INPUT_LOG_BAUD 115200
+
+// Changes in a joystick reading and in a touch coordinate that are noise,
+// and are not recorded.
+#define INPUT_LOG_JOY_NOISE 4
+#define INPUT_LOG_TOUCH_NOISE 8
+
+#ifdef RECORD_INPUT
+
+// Record the input if it has changed since it was last recorded.
+void recordInput(int v, int h, bool sel, int tx, int ty, int tz);
+
+#define RECORD_INPUT_SAMPLE(v, h, sel, tx, ty, tz) recordInput(v, h, sel, tx, ty, tz)
+
+#else
+
+#define RECORD_INPUT_SAMPLE(v, h, sel, tx, ty, tz)
+
+#endif
+
+#endif
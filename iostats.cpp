@@ -0,0 +1,62 @@
+#include "iostats.h"
+
+const char* const ioOpNames[NUM_IO_OPS] = {
+	"idle", "list", "page", "scroll", "tap", "select", "search"
+};
+
+#ifdef IO_STATS
+
+uint8_t ioOp = IO_IDLE;
+IoCounters ioStats;
+uint16_t ioSeq;
+
+/*
+	Prints one labelled counter of an I/O report.
+
+	Arguments:
+		label (const char*): name of the counter
+		count (uint32_t): its value
+
+	Returns:
+		None
+*/
+static void printCount(const char* label, uint32_t count) {
+	Serial.print(' ');
+	Serial.print(label);
+	Serial.print('=');
+	Serial.print(count);
+}
+
+/*
+	Prints the I/O charged to the current interaction on one line, unless
+	there was none, then resets the counters and charges the I/O from now on
+	to the given interaction.
+
+	Arguments:
+		op (uint8_t): the interaction being started, an IoOp
+
+	Returns:
+		None
+*/
+void ioBegin(uint8_t op) {
+	const IoCounters& s = ioStats;
+	if (s.blockReads || s.cacheHits || s.fileOpens || s.tftBytes) {
+		Serial.print("io ");
+		Serial.print(ioOpNames[ioOp]);
+		printCount("blocks", s.blockReads);
+		printCount("cmds", s.sdCommands);
+		printCount("hits", s.cacheHits);
+		printCount("misses", s.cacheMisses);
+		printCount("opens", s.fileOpens);
+		printCount("seeks", s.fileSeeks);
+		printCount("read", s.bytesRead);
+		printCount("tft", s.tftBytes);
+		Serial.println();
+	}
+
+	memset(&ioStats, 0, sizeof(ioStats));
+	ioOp = op;
+	ioSeq++;
+}
+
+#endif
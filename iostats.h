@@ -0,0 +1,71 @@
+/*
+	Accounting of the I/O done on behalf of each user interaction: raw block
+	reads and restaurant cache hits and misses from getRestaurant(), opens,
+	seeks and bytes read through the SD file system, and bytes pushed to the
+	TFT. Everything counted is charged to the interaction that was started
+	last, including the background work it set off (the list build, the map
+	being drawn a slice at a time), and the totals for an interaction are
+	printed over serial when the next one starts.
+
+	Accounting is compiled in with -DIO_STATS (make IO_STATS=1), and costs
+	nothing otherwise.
+*/
+
+#ifndef _IOSTATS_H_
+#define _IOSTATS_H_
+
+#include <Arduino.h>
+
+// The user interactions that I/O is charged to.
+enum IoOp {
+  IO_IDLE,     // nothing started yet
+  IO_LIST,     // joystick click, building and showing the restaurant list
+  IO_PAGE,     // scrolling the list to a restaurant off the display
+  IO_SCROLL,   // nudging the edge of the map so it is redrawn
+  IO_TAP,      // touching the map for the markers, or a button
+  IO_SELECT,   // picking a restaurant, which redraws the map around it
+  IO_SEARCH,   // typing on the keyboard, which looks up the name typed
+  NUM_IO_OPS
+};
+
+// Names of the interactions, as printed.
+extern const char* const ioOpNames[NUM_IO_OPS];
+
+// I/O charged to one interaction.
+struct IoCounters {
+  uint32_t blockReads;  // raw blocks read from the card
+  uint32_t sdCommands;  // raw read commands sent to the card, a streamed
+                        // run of blocks taking two however long it is
+  uint32_t cacheHits;   // getRestaurant() calls served from the cached block
+  uint32_t cacheMisses; // getRestaurant() calls that read a block
+  uint32_t fileOpens;   // files opened, each walking the FAT directory
+  uint32_t fileSeeks;   // seeks within a file, each following the cluster chain
+  uint32_t bytesRead;   // bytes read from the card, raw or through files
+  uint32_t tftBytes;    // bytes of pixels pushed to the display by image
+                        // draws, fills and the menu (other text is not
+                        // counted)
+};
+
+#ifdef IO_STATS
+
+extern uint8_t ioOp;
+extern IoCounters ioStats;
+
+// Number of interactions started so far, so that a host tool can tell two
+// interactions of the same kind apart.
+extern uint16_t ioSeq;
+
+// Print the I/O of the current interaction and start charging I/O to op.
+void ioBegin(uint8_t op);
+
+#define IO_BEGIN(op) ioBegin(op)
+#define IO_COUNT(field, n) (ioStats.field += (n))
+
+#else
+
+#define IO_BEGIN(op)
+#define IO_COUNT(field, n)
+
+#endif
+
+#endif
@@ -0,0 +1,132 @@
+#include "joystick.h"
+
+// Acceleration curve: cursor speed in pixels per second at evenly spaced
+// deflections from the edge of the dead zone to the end of travel. Speeds in
+// between are interpolated, so small deflections give fine control and full
+// deflection crosses the screen in about a second and a half.
+const int16_t joySpeedCurve[] = { 20, 30, 45, 70, 100, 140, 190, 250, 320 };
+#define JOY_CURVE_STEPS (sizeof(joySpeedCurve)/sizeof(joySpeedCurve[0]) - 1)
+#define JOY_TRAVEL (JOY_CENTRE - JOY_DEADZONE)
+
+/*
+	Sets up the pins of the joystick and clears its state.
+
+	Arguments:
+		js (Joystick*): pointer to the joystick
+		vertPin (uint8_t): analog pin of the vertical axis
+		horizPin (uint8_t): analog pin of the horizontal axis
+		selPin (uint8_t): digital pin of the button
+
+	Returns:
+		None
+*/
+void joystickInit(Joystick* js, uint8_t vertPin, uint8_t horizPin, uint8_t selPin) {
+	js->vertPin = vertPin;
+	js->horizPin = horizPin;
+	js->selPin = selPin;
+	js->v = js->h = JOY_CENTRE;
+	js->held = js->clicked = false;
+	js->motionX = js->motionY = 0;
+	js->lastSample = millis();
+
+	pinMode(selPin, INPUT_PULLUP);
+}
+
+/*
+	Computes the speed of the cursor for a reading of one axis of the stick.
+
+	Arguments:
+		reading (int): analog reading of the axis
+
+	Returns:
+		Speed in pixels per second, negative below the centre, 0 in the dead zone
+*/
+int16_t joystickSpeed(int reading) {
+	int16_t d = abs(reading - JOY_CENTRE) - JOY_DEADZONE;
+	if (d <= 0) {
+		return 0;
+	}
+	d = min(d, JOY_TRAVEL - 1);
+
+	// interpolate between the two nearest points of the curve
+	int32_t pos = (int32_t) d * JOY_CURVE_STEPS;
+	int i = pos / JOY_TRAVEL, rem = pos % JOY_TRAVEL;
+	int16_t speed = joySpeedCurve[i]
+		+ (int32_t) (joySpeedCurve[i+1] - joySpeedCurve[i]) * rem / JOY_TRAVEL;
+
+	return (reading < JOY_CENTRE) ? -speed : speed;
+}
+
+/*
+	Reads the joystick, latches a press of the button on its leading edge and
+	adds the distance the cursor travels since the previous sample to the
+	motion not taken yet.
+
+	Arguments:
+		js (Joystick*): pointer to the joystick
+
+	Returns:
+		None
+*/
+void joystickSample(Joystick* js) {
+	uint32_t now = millis();
+	int32_t dt = min(now - js->lastSample, (uint32_t) JOY_MAX_DT);
+	js->lastSample = now;
+
+	js->v = analogRead(js->vertPin);
+	js->h = analogRead(js->horizPin);
+
+	bool held = (digitalRead(js->selPin) == LOW);
+	if (held && !js->held) {
+		js->clicked = true;
+	}
+	js->held = held;
+
+	// the horizontal axis reads lower to the right
+	int16_t vx = -joystickSpeed(js->h), vy = joystickSpeed(js->v);
+
+	// drop leftover fractions of a pixel once the stick is let go
+	if (vx == 0 && abs(js->motionX) < (1 << JOY_FRAC_BITS)) {
+		js->motionX = 0;
+	}
+	if (vy == 0 && abs(js->motionY) < (1 << JOY_FRAC_BITS)) {
+		js->motionY = 0;
+	}
+
+	js->motionX += (int32_t) vx * dt * (1 << JOY_FRAC_BITS) / 1000;
+	js->motionY += (int32_t) vy * dt * (1 << JOY_FRAC_BITS) / 1000;
+}
+
+/*
+	Takes the whole pixels of cursor motion accumulated since the last time
+	motion was taken, leaving the fractions of a pixel for later.
+
+	Arguments:
+		js (Joystick*): pointer to the joystick
+		dx (int16_t*): set to the motion to the right
+		dy (int16_t*): set to the motion down
+
+	Returns:
+		None
+*/
+void joystickTakeMotion(Joystick* js, int16_t* dx, int16_t* dy) {
+	*dx = js->motionX / (1 << JOY_FRAC_BITS);
+	*dy = js->motionY / (1 << JOY_FRAC_BITS);
+	js->motionX -= (int32_t) *dx * (1 << JOY_FRAC_BITS);
+	js->motionY -= (int32_t) *dy * (1 << JOY_FRAC_BITS);
+}
+
+/*
+	Takes a press of the button.
+
+	Arguments:
+		js (Joystick*): pointer to the joystick
+
+	Returns:
+		true if the button was pressed since the last call, false otherwise
+*/
+bool joystickTakeClick(Joystick* js) {
+	bool clicked = js->clicked;
+	js->clicked = false;
+	return clicked;
+}
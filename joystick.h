@@ -0,0 +1,49 @@
+/*
+	Joystick input sampled on a fixed timer. The cursor velocity given by the
+	deflection of the stick is integrated over the time between samples, so
+	the speed of the cursor does not depend on how long the main loop takes
+	and a single redraw can take the motion of many samples at once.
+*/
+
+#ifndef _JOYSTICK_H_
+#define _JOYSTICK_H_
+
+#include <Arduino.h>
+
+// constants for the joystick
+#define JOY_DEADZONE 64
+#define JOY_CENTRE 512
+
+// Longest gap between two samples that is integrated, in milliseconds, so
+// the cursor does not jump after the loop has been held up.
+#define JOY_MAX_DT 50
+
+// Motion is accumulated in fixed point with this many fractional bits.
+#define JOY_FRAC_BITS 8
+
+struct Joystick {
+  uint8_t vertPin, horizPin, selPin;
+  int v, h;                 // latest readings of the stick
+  bool held;                // button is down
+  bool clicked;             // button was pressed since the last click was taken
+  uint32_t lastSample;      // millis() of the last sample
+  int32_t motionX, motionY; // cursor motion not taken yet, in fixed point pixels
+};
+
+// Set up the pins of the joystick.
+void joystickInit(Joystick* js, uint8_t vertPin, uint8_t horizPin, uint8_t selPin);
+
+// Read the joystick and integrate the cursor motion since the last sample.
+void joystickSample(Joystick* js);
+
+// Take the whole pixels of cursor motion accumulated so far.
+void joystickTakeMotion(Joystick* js, int16_t* dx, int16_t* dy);
+
+// Take a press of the button, returning true if there was one.
+bool joystickTakeClick(Joystick* js);
+
+// Speed of the cursor in pixels per second for a reading of one axis,
+// following the acceleration curve. Negative below the centre.
+int16_t joystickSpeed(int reading);
+
+#endif
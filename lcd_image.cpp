@@ -8,6 +8,11 @@
 #include <SD.h>
 
 #include "lcd_image.h"
+#include "sdcard.h"
+#include "sdstream.h"
+#include "iostats.h"
+#include "scheduler.h"
+#include "trace.h"
 
 /* Draws the referenced image to the LCD screen.
  *
@@ -22,47 +27,261 @@ void lcd_image_draw(const lcd_image_t *img, MCUFRIEND_kbv *tft,
 		    uint16_t scol, uint16_t srow,
 		    uint16_t width, uint16_t height)
 {
+  lcd_image_job_t job;
+
+  lcd_image_job_start(&job, img, icol, irow, scol, srow, width, height);
+  lcd_image_job_step(&job, tft, NO_BUDGET);
+}
+
+/* Finds the image in consecutive blocks of the card, so that it is drawn by
+ * streaming its rows from the card rather than seeking to them through the
+ * file system.
+ */
+bool lcd_image_locate(lcd_image_t *img, Sd2Card *card)
+{
+  uint32_t first, count;
+
+  img->block = 0;
+  if (!streamLocate(card, img->file_name, &first, &count) ||
+      count * 512 < 2 * (uint32_t) img->ncols * img->nrows) {
+    return false;
+  }
+
+  img->card = card;
+  img->block = first;
+  return true;
+}
+
+/* Prepares a job to draw the referenced image, with the same arguments as
+ * lcd_image_draw. Nothing is drawn until the job is stepped.
+ */
+void lcd_image_job_start(lcd_image_job_t *job, const lcd_image_t *img,
+			 uint16_t icol, uint16_t irow,
+			 uint16_t scol, uint16_t srow,
+			 uint16_t width, uint16_t height)
+{
+  job->img = img;
+  job->icol = icol;
+  job->irow = irow;
+  job->scol = scol;
+  job->srow = srow;
+  job->width = width;
+  job->height = height;
+  job->row = 0;
+  job->tries = 0;
+}
+
+/* Position in the file of the first pixel of a row of the job, which needs
+ * 32 bit arithmetic for big images.
+ */
+static uint32_t row_pos(const lcd_image_job_t *job, uint16_t row)
+{
+  return ((uint32_t) job->irow + (uint32_t) row) * (2 * (uint32_t) job->img->ncols)
+    + (uint32_t) job->icol * 2;
+}
+
+/* Swaps the bytes of n pixels read from the card, which are in reverse
+ * order there.
+ */
+static void swap_pixels(uint16_t *pixels, uint16_t n)
+{
+  for (uint16_t col = 0; col < n; col++) {
+    uint16_t pixel = pixels[col];
+    pixels[col] = (pixel << 8) | (pixel >> 8);
+  }
+}
+
+/* Draws rows of the job, reading them through the file system.
+ */
+static void file_rows(lcd_image_job_t *job, MCUFRIEND_kbv *tft,
+                      uint32_t start, uint16_t budget)
+{
+  const lcd_image_t *img = job->img;
+  uint16_t width = job->width;
   File file;
 
-  // Open requested file on SD card if not already open
+  // Open requested file on SD card, once per slice of the job
   if ((file = SD.open(img->file_name)) == NULL) {
-    Serial.print("File not found:'");
+    Serial.print(F("File not found:'"));
     Serial.print(img->file_name);
     Serial.println('\'');
+    job->row = job->height;
     return;  // how do we inform the caller than things went wrong?
   }
+  IO_COUNT(fileOpens, 1);
+
+  // always draw at least one row so the job makes progress
+  do {
+    uint16_t row = job->row;
+    // Seek to start of pixels to read from
+    file.seek(row_pos(job, row));
+    IO_COUNT(fileSeeks, 1);
+
+    tft->startWrite();
+    tft->setAddrWindow(job->scol, job->srow+row, job->scol+width-1, job->srow+row);
+
+    // Read the row a chunk at a time and send it to the display
+    for (uint16_t col = 0; col < width && job->row == row; col += LCD_ROW_CHUNK) {
+      uint16_t n = min(width - col, LCD_ROW_CHUNK);
+      uint16_t pixels[LCD_ROW_CHUNK];
+      if (file.read((uint8_t *) pixels, 2 * n) != 2 * n) {
+        Serial.println(F("SD Card Read Error!"));
+        job->row = job->height;
+        break;
+      }
+      IO_COUNT(bytesRead, 2 * n);
+
+      swap_pixels(pixels, n);
+      tft->pushColors(pixels, n, col == 0);
+    }
+
+    tft->endWrite();
+    if (job->row == row) {
+      IO_COUNT(tftBytes, 2 * width);
+      job->row++;
+    }
+  } while (lcd_image_job_active(job) && withinBudget(start, budget));
+
+  file.close();
+}
+
+/* A chunk of a row of the job being sent to the display a pixel at a time,
+ * while the card is busy sending the next chunk into the same buffer.
+ */
+typedef struct {
+  MCUFRIEND_kbv *tft;
+  uint16_t *pixels;
+  uint16_t col, width;  // next pixel to send, and pixels in the chunk
+  bool first;           // no pixel sent yet since the address window was set
+} lcd_image_pipe_t;
+
+/* Sends the next pixel of the chunk to the display, as a step of the work
+ * the stream does while it waits on the card (see streamOverlap).
+ */
+static bool push_pixel(void *ctx)
+{
+  lcd_image_pipe_t *pipe = (lcd_image_pipe_t *) ctx;
+
+  if (pipe->col >= pipe->width) {
+    return false;
+  }
+
+  // pixel bytes in reverse order on card
+  uint16_t pixel = pipe->pixels[pipe->col++];
+  pixel = (pixel << 8) | (pixel >> 8);
+  pipe->tft->pushColors(&pixel, 1, pipe->first);
+  pipe->first = false;
+
+  return pipe->col < pipe->width;
+}
+
+/* Draws rows of the job streamed from the blocks of the image on the card,
+ * in one stream for rows less than LCD_STREAM_GAP bytes apart.
+ *
+ * The rows are pipelined a chunk of LCD_ROW_CHUNK pixels at a time: each
+ * chunk is sent to the display a pixel for every byte that goes over SPI
+ * to fetch the next, from stopping and starting the stream to reading the
+ * chunk itself. The next chunk is read into the same buffer, which is safe
+ * because a pixel is always sent before the two bytes of the next chunk
+ * that replace it have arrived. A chunk that fails to read is read again
+ * from where it starts, the chunks before it having been sent.
+ */
+static void stream_rows(lcd_image_job_t *job, MCUFRIEND_kbv *tft,
+                        uint32_t start, uint16_t budget)
+{
+  const lcd_image_t *img = job->img;
+  uint16_t width = job->width;
+  uint16_t pixels[LCD_ROW_CHUNK];
+  lcd_image_pipe_t pipe = { tft, pixels, 0, 0, true };
+  bool streaming = false;
+  uint32_t at = 0;  // position of the stream in the file
+  uint16_t col = 0; // next pixel of the row to read
+
+  tft->startWrite();
+  // the rows left of the patch are sent as one window
+  tft->setAddrWindow(job->scol, job->srow+job->row,
+                     job->scol+width-1, job->srow+job->height-1);
+
+  // always draw at least one row so the job makes progress, and finish
+  // the row started
+  do {
+    uint32_t pos = row_pos(job, job->row) + 2 * col;
+    uint16_t n = min(width - col, LCD_ROW_CHUNK);
 
-  for (uint16_t row=0; row < height; row++) {
-    uint16_t pixels[width];
-    // Seek to start of pixels to read from, need 32 bit arith for big images
-    uint32_t pos = ( (uint32_t) irow +  (uint32_t) row) *
-      (2 *  (uint32_t) img->ncols) +  (uint32_t) icol * 2;
-    file.seek(pos);
-
-    // Read row of pixels
-    if (file.read((uint8_t *) pixels, 2 * width) != 2 * width) {
-      Serial.println("SD Card Read Error!");
-      file.close();
-      return;
+    if (streaming && pos - at > LCD_STREAM_GAP) {
+      streamStop();
+      streaming = false;
+    }
+    if (!streaming) {
+      streaming = streamStart(img->card, img->block + pos / 512);
+      at = pos - pos % 512;
     }
 
-		tft->startWrite();
-		// Setup display to receive window of pixels
-		// tft->setAddrWindow(scol, srow+row, width, 1);
-		tft->setAddrWindow(scol, srow+row, scol+width-1, srow+row);
+    // a failed chunk is read again with a new stream, a few times at most
+    if (!streaming || !streamRead(NULL, pos - at) ||
+        !streamRead((uint8_t *) pixels, 2 * n)) {
+      if (streaming) {
+        streamStop();
+        streaming = false;
+      }
+      if (++job->tries < CARD_READ_TRIES) {
+        continue;
+      }
+      cardErrors.failures++;
+      Serial.println(F("SD Card Read Error!"));
+      job->row = job->height;
+      break;
+    }
+    at = pos + 2 * n;
+    job->tries = 0;
 
-    // Send pixels to display
-    for (uint16_t col=0; col < width; col++) {
-      uint16_t pixel = pixels[col];
+    // send the chunk while the next one is fetched, once the last is sent
+    streamOverlapFinish();
+    pipe.col = 0;
+    pipe.width = n;
+    streamOverlap(push_pixel, &pipe);
 
-      // pixel bytes in reverse order on card
-      pixel = (pixel << 8) | (pixel >> 8);
-			//tft->writePixel(scol+col, srow+row, pixel);
-      pixels[col] = pixel;
+    col += n;
+    if (col == width) {
+      IO_COUNT(tftBytes, 2 * width);
+      job->row++;
+      col = 0;
     }
+  } while (col > 0 || (lcd_image_job_active(job) && withinBudget(start, budget)));
 
-    tft->pushColors(pixels, width, true);
-		tft->endWrite();
+  if (streaming) {
+    streamStop();
   }
-  file.close();
+  streamOverlapFinish();
+  tft->endWrite();
+}
+
+/* Draws rows of the job until it is finished or budget milliseconds have
+ * passed (NO_BUDGET to finish it). Returns true once the job is finished.
+ */
+bool lcd_image_job_step(lcd_image_job_t *job, MCUFRIEND_kbv *tft,
+			uint16_t budget)
+{
+  uint32_t start = millis();
+
+  if (!lcd_image_job_active(job)) {
+    return true;
+  }
+
+  TRACE_SCOPE(TRACE_IMAGE_DRAW);
+
+  if (job->img->block != 0) {
+    stream_rows(job, tft, start, budget);
+  } else {
+    file_rows(job, tft, start, budget);
+  }
+
+  return !lcd_image_job_active(job);
+}
+
+/* Returns true if the job has rows left to draw.
+ */
+bool lcd_image_job_active(const lcd_image_job_t *job)
+{
+  return job->row < job->height;
 }
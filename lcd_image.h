@@ -6,13 +6,40 @@
 #define _LCD_IMAGE_H
 
 #include <MCUFRIEND_kbv.h>
+#include <SD.h>
 
 typedef struct {
   char file_name[50];
   uint16_t ncols;
   uint16_t nrows;
+  Sd2Card *card;    // card the image is streamed from, see lcd_image_locate
+  uint32_t block;   // first block of the file, 0 to read it through the files
 } lcd_image_t;
 
+/* Rows of an image closer together on the card than this many bytes are
+ * streamed without stopping, skipping the bytes between them. It is about
+ * what the card sends in the time it takes to stop a stream and start the
+ * next.
+ */
+#define LCD_STREAM_GAP 256
+
+/* Rows are read and sent to the display this many pixels at a time, so the
+ * buffer on the stack stays small however wide the patch is.
+ */
+#define LCD_ROW_CHUNK 210
+
+/* An image patch being drawn a few rows at a time, so a large draw can be
+ * spread over several passes of the main loop.
+ */
+typedef struct {
+  const lcd_image_t *img;
+  uint16_t icol, irow;
+  uint16_t scol, srow;
+  uint16_t width, height;
+  uint16_t row;            // next row of the patch to draw
+  uint8_t tries;           // failed reads of the row, see CARD_READ_TRIES
+} lcd_image_job_t;
+
 /* Draws the referenced image to the LCD screen.
  *
  * img           : the image to draw
@@ -26,4 +53,30 @@ void lcd_image_draw(const lcd_image_t *img, MCUFRIEND_kbv *tft,
 		    uint16_t scol, uint16_t srow,
 		    uint16_t width, uint16_t height);
 
+/* Finds the image in consecutive blocks of the card, so that it is drawn by
+ * streaming its rows from the card (see sdstream.h) rather than seeking to
+ * them through the file system. Returns false, leaving the image to be read
+ * through the file system, if its file is not in consecutive blocks. Like
+ * streamLocate(), it must be called before SD.begin().
+ */
+bool lcd_image_locate(lcd_image_t *img, Sd2Card *card);
+
+/* Prepares a job to draw the referenced image, with the same arguments as
+ * lcd_image_draw. Nothing is drawn until the job is stepped.
+ */
+void lcd_image_job_start(lcd_image_job_t *job, const lcd_image_t *img,
+			 uint16_t icol, uint16_t irow,
+			 uint16_t scol, uint16_t srow,
+			 uint16_t width, uint16_t height);
+
+/* Draws rows of the job until it is finished or budget milliseconds have
+ * passed (NO_BUDGET to finish it). Returns true once the job is finished.
+ */
+bool lcd_image_job_step(lcd_image_job_t *job, MCUFRIEND_kbv *tft,
+			uint16_t budget);
+
+/* Returns true if the job has rows left to draw.
+ */
+bool lcd_image_job_active(const lcd_image_job_t *job);
+
 #endif
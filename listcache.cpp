@@ -0,0 +1,135 @@
+#include "listcache.h"
+
+/*
+	Empties the cache, so that every list is built from the card, and
+	clears its counts of hits and misses.
+
+	Arguments:
+		c (ListCache*): pointer to the cache
+
+	Returns:
+		None
+*/
+void listCacheClear(ListCache* c) {
+	memset(c, 0, sizeof(*c));
+}
+
+/*
+	Finds the cell of the near table holding a coordinate of a point.
+
+	Arguments:
+		p (int16_t): the coordinate, in pixels of the map at the zoom level
+		zoom (uint8_t): zoom level of the map the point is on
+
+	Returns:
+		The column or row of the cell
+*/
+static int16_t cellOf(int16_t p, uint8_t zoom) {
+	return rezoom(p, zoom, 0) >> NEAR_SHIFT;
+}
+
+/*
+	Checks if an entry holds the list of a build.
+
+	Arguments:
+		e (const ListCacheEntry&): pass-by-reference to the entry
+		lb (const ListBuild*): pointer to the list build
+
+	Returns:
+		true if the entry is for the cell of the cursor, zoom level, rating and metric of the build
+*/
+static bool holds(const ListCacheEntry& e, const ListBuild* lb) {
+	const MapView& mv = lb->mv;
+	return e.rating == lb->rating && e.metric == lb->metric && e.zoom == mv.zoom &&
+		cellOf(e.x, mv.zoom) == cellOf(mv.mapX + mv.cursorX, mv.zoom) &&
+		cellOf(e.y, mv.zoom) == cellOf(mv.mapY + mv.cursorY, mv.zoom);
+}
+
+/*
+	Moves an entry to the front of the cache, shifting the entries used more
+	recently than it back by one, so the last entry is always the least
+	recently used.
+
+	Arguments:
+		c (ListCache*): pointer to the cache
+		k (int): position of the entry
+
+	Returns:
+		None
+*/
+static void moveToFront(ListCache* c, int k) {
+	if (k == 0) {
+		return;
+	}
+	ListCacheEntry e = c->entry[k];
+	memmove(&c->entry[1], &c->entry[0], k * sizeof(ListCacheEntry));
+	c->entry[0] = e;
+}
+
+/*
+	Looks up the list of a build that has just been started, and on a hit
+	starts the build from the cached first page, which is then ready at
+	once. The build is moved to the point the page was built for, so the
+	rest of the list, built from the card as usual, is of the same point.
+
+	Arguments:
+		c (ListCache*): pointer to the cache
+		lb (ListBuild*): pointer to the list build, just started
+		restaurants[] (RestDist): array the list is built in
+
+	Returns:
+		true if the first page was cached
+*/
+bool listCacheStart(ListCache* c, ListBuild* lb, RestDist restaurants[]) {
+	for (int k = 0; k < LIST_CACHE_ENTRIES; k++) {
+		if (holds(c->entry[k], lb)) {
+			moveToFront(c, k);
+			const ListCacheEntry& e = c->entry[0];
+			lb->mv.cursorX = e.x - lb->mv.mapX;
+			lb->mv.cursorY = e.y - lb->mv.mapY;
+			memcpy(restaurants, e.page, e.count * sizeof(RestDist));
+			listFromPage(lb, e.count, e.total);
+			c->hits++;
+			return true;
+		}
+	}
+
+	c->misses++;
+	return false;
+}
+
+/*
+	Keeps the first page of a build in the cache, in place of the entry
+	already holding its list, or else of the least recently used one.
+
+	Arguments:
+		c (ListCache*): pointer to the cache
+		lb (const ListBuild*): pointer to the list build, with its first page ready
+		restaurants[] (const RestDist): array the list is built in
+
+	Returns:
+		None
+*/
+void listCacheStore(ListCache* c, const ListBuild* lb, const RestDist restaurants[]) {
+	if (lb->total < 0) {
+		return;
+	}
+
+	int k = LIST_CACHE_ENTRIES - 1;
+	for (int i = 0; i < LIST_CACHE_ENTRIES; i++) {
+		if (holds(c->entry[i], lb)) {
+			k = i;
+		}
+	}
+	moveToFront(c, k);
+
+	ListCacheEntry& e = c->entry[0];
+	e.x = lb->mv.mapX + lb->mv.cursorX;
+	e.y = lb->mv.mapY + lb->mv.cursorY;
+	e.zoom = lb->mv.zoom;
+	e.rating = lb->rating;
+	e.metric = lb->metric;
+	e.count = min(lb->ready, REST_PAGE_SIZE);
+	e.total = lb->total;
+	memcpy(e.page, restaurants, e.count * sizeof(RestDist));
+}
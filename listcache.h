@@ -0,0 +1,57 @@
+/*
+	A small cache of the first pages of the lists built around the cursor,
+	so that clicking again where the list was last built, or going back to a
+	rating or metric after trying another, shows the menu without reading
+	the card again. The rest of the list is then built in the background as
+	usual, skipping the page.
+
+	A list is keyed by everything it depends on: the cell of the near table
+	(see neartable.h) holding the cursor, the zoom level, the rating and the
+	metric. The sort mode is not part of the key, since every sort engine
+	puts the list in the same order. Clicking anywhere in the cell of a
+	cached page gives the list of the point the page was built for rather
+	than of the cursor: it is built around that point, at most a cell (64
+	pixels of the full size map) away in each direction, so the page and
+	the rest of the list agree. The cursor itself is not moved.
+*/
+
+#ifndef _LISTCACHE_H_
+#define _LISTCACHE_H_
+
+#include <Arduino.h>
+#include "restaurant.h"
+#include "neartable.h"
+
+// Number of first pages the cache holds.
+#define LIST_CACHE_ENTRIES 3
+
+// The first page of the list of one cell, rating and metric.
+struct ListCacheEntry {
+  int16_t x, y;    // point the list was built around, in pixels of the map at the zoom level
+  uint8_t zoom;
+  int8_t rating;   // minimum rating of the list, 0 if the entry is empty
+  int8_t metric;
+  uint8_t count;   // restaurants of the page held
+  int16_t total;   // restaurants of the complete list
+  RestDist page[REST_PAGE_SIZE];
+};
+
+// The cached pages, most recently used first, and how often a list was
+// found in them.
+struct ListCache {
+  uint16_t hits, misses;
+  ListCacheEntry entry[LIST_CACHE_ENTRIES];
+};
+
+// Empty the cache and its counts.
+void listCacheClear(ListCache* c);
+
+// Look up the list of a build just started. If it is cached, copy its first
+// page into restaurants[] and start the build from it (see listFromPage()),
+// around the point the page was built for. Returns true if it was cached.
+bool listCacheStart(ListCache* c, ListBuild* lb, RestDist restaurants[]);
+
+// Keep the first page of a build once it is ready (see listReady()).
+void listCacheStore(ListCache* c, const ListBuild* lb, const RestDist restaurants[]);
+
+#endif
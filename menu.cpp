@@ -0,0 +1,251 @@
+#include "menu.h"
+#include "iostats.h"
+
+// size of a character cell of the font at size 1, and at the size of the menu
+#define GLYPH_WIDTH  6
+#define GLYPH_HEIGHT 8
+#define MENU_SIZE    2
+#define CELL_WIDTH   (GLYPH_WIDTH * MENU_SIZE)
+#define CELL_HEIGHT  (GLYPH_HEIGHT * MENU_SIZE)
+
+// A name on the display, without its terminator.
+struct MenuRow {
+	char name[MENU_COLS];
+	uint8_t length;
+};
+
+// A glyph of the font as the library draws it: five columns of eight dots,
+// lowest dot in the highest bit, as the font itself holds them.
+struct Glyph {
+	char c;
+	uint8_t column[GLYPH_WIDTH - 1];
+};
+
+static MenuRow rows[MENU_ROWS];
+static uint8_t selected;
+static Glyph glyphs[GLYPH_SLOTS];
+
+// The glyphs are drawn into a canvas by the library to read them back, so
+// they are the glyphs of whichever font it has.
+static GFXcanvas1 canvas(GLYPH_WIDTH, GLYPH_HEIGHT);
+
+/*
+	Finds the bitmap of a glyph in the cache, drawing it into the cache
+	slot of its code if it is not there.
+
+	Arguments:
+		c (char): the character
+
+	Returns:
+		The cached glyph
+*/
+static const Glyph* glyph(char c) {
+	Glyph* g = &glyphs[(uint8_t) c % GLYPH_SLOTS];
+	if (g->c == c) {
+		return g;
+	}
+
+	canvas.fillScreen(0);
+	canvas.drawChar(0, 0, c, 1, 0, 1);
+	const uint8_t* bits = canvas.getBuffer();
+	for (uint8_t i = 0; i < GLYPH_WIDTH - 1; i++) {
+		uint8_t column = 0;
+		for (uint8_t j = 0; j < GLYPH_HEIGHT; j++) {
+			if (bits[j] & (0x80 >> i)) {
+				column |= 1 << j;
+			}
+		}
+		g->column[i] = column;
+	}
+	g->c = c;
+	return g;
+}
+
+/*
+	Works out one scanline of a character cell of the display, as the rows
+	printed at size 2 from the top leave it: the first line of a row shows
+	the row above where the row itself has no character.
+
+	Arguments:
+		y (int16_t): the scanline of the display
+		col (uint8_t): the column of the cell
+		pixels (uint16_t*): set to the CELL_WIDTH pixels of the cell
+
+	Returns:
+		None
+*/
+static void cellLine(int16_t y, uint8_t col, uint16_t* pixels) {
+	uint8_t row = y / MENU_PITCH;
+	uint8_t line = y % MENU_PITCH;
+
+	if (row >= MENU_ROWS || col >= rows[row].length) {
+		if (line == 0 && row > 0 && col < rows[row - 1].length) {
+			row--;
+			line = MENU_PITCH;
+		} else {
+			for (uint8_t x = 0; x < CELL_WIDTH; x++) {
+				pixels[x] = TFT_BLACK;
+			}
+			return;
+		}
+	}
+
+	uint16_t fg = TFT_WHITE, bg = TFT_BLACK;
+	if (row == selected) {
+		fg = TFT_BLACK;
+		bg = TFT_WHITE;
+	}
+
+	const Glyph* g = glyph(rows[row].name[col]);
+	uint8_t dot = line / MENU_SIZE;
+	for (uint8_t i = 0; i < GLYPH_WIDTH; i++) {
+		uint16_t colour = (i < GLYPH_WIDTH - 1 && (g->column[i] >> dot) & 1) ? fg : bg;
+		for (uint8_t s = 0; s < MENU_SIZE; s++) {
+			pixels[i * MENU_SIZE + s] = colour;
+		}
+	}
+}
+
+/*
+	Redraws columns of a row, down to the line it shares with the row below,
+	as one address window.
+
+	Arguments:
+		tft (MCUFRIEND_kbv*): the display
+		row (uint8_t): the row
+		first (uint8_t): first column to draw
+		end (uint8_t): column after the last to draw
+
+	Returns:
+		None
+*/
+static void drawRow(MCUFRIEND_kbv* tft, uint8_t row, uint8_t first, uint8_t end) {
+	if (first >= end) {
+		return;
+	}
+
+	int16_t top = row * MENU_PITCH;
+	tft->startWrite();
+	tft->setAddrWindow(first * CELL_WIDTH, top, end * CELL_WIDTH - 1, top + CELL_HEIGHT - 1);
+	bool start = true;
+	for (int16_t y = top; y < top + CELL_HEIGHT; y++) {
+		for (uint8_t col = first; col < end; col++) {
+			uint16_t pixels[CELL_WIDTH];
+			cellLine(y, col, pixels);
+			tft->pushColors(pixels, CELL_WIDTH, start);
+			start = false;
+		}
+	}
+	tft->endWrite();
+	IO_COUNT(tftBytes, 2L * (end - first) * CELL_WIDTH * CELL_HEIGHT);
+}
+
+/*
+	Shows a name in a row, redrawing the columns from the first character
+	that changes to the last.
+
+	Arguments:
+		tft (MCUFRIEND_kbv*): the display
+		row (uint8_t): the row
+		name (const char*): the name, of which only length characters are used
+		length (uint8_t): characters of the name to show, at most MENU_COLS
+
+	Returns:
+		None
+*/
+static void setRow(MCUFRIEND_kbv* tft, uint8_t row, const char* name, uint8_t length) {
+	MenuRow* r = &rows[row];
+	uint8_t end = max(length, r->length);
+
+	// past the end of a name, a cell is blank
+	uint8_t first = 0;
+	while (first < end && first < length && first < r->length && r->name[first] == name[first]) {
+		first++;
+	}
+	while (end > first && end <= length && end <= r->length && r->name[end - 1] == name[end - 1]) {
+		end--;
+	}
+
+	memmove(r->name, name, length);
+	r->length = length;
+	drawRow(tft, row, first, end);
+}
+
+/*
+	Forgets the rows, as when the display has been cleared to black, and
+	highlights the first.
+
+	Arguments:
+		None
+
+	Returns:
+		None
+*/
+void menuClear() {
+	for (uint8_t row = 0; row < MENU_ROWS; row++) {
+		rows[row].length = 0;
+	}
+	selected = 0;
+}
+
+/*
+	Shows a name in a row of the menu.
+
+	Arguments:
+		tft (MCUFRIEND_kbv*): the display
+		row (uint8_t): the row
+		name (const char*): the name, cut to MENU_COLS characters
+
+	Returns:
+		None
+*/
+void menuSetRow(MCUFRIEND_kbv* tft, uint8_t row, const char* name) {
+	setRow(tft, row, name, strnlen(name, MENU_COLS));
+}
+
+/*
+	Moves the highlight to a row, redrawing it and the row that had it.
+
+	Arguments:
+		tft (MCUFRIEND_kbv*): the display
+		row (uint8_t): the row
+
+	Returns:
+		None
+*/
+void menuSelect(MCUFRIEND_kbv* tft, uint8_t row) {
+	if (row == selected) {
+		return;
+	}
+	uint8_t old = selected;
+	selected = row;
+	drawRow(tft, old, 0, rows[old].length);
+	drawRow(tft, row, 0, rows[row].length);
+}
+
+/*
+	Scrolls the rows by one. Each row is redrawn where it differs from the
+	one it replaces, in the order that leaves the line shared by two rows as
+	printing them from the top would.
+
+	Arguments:
+		tft (MCUFRIEND_kbv*): the display
+		dir (int8_t): > 0 to move the rows up, < 0 to move them down
+		name (const char*): the name of the row scrolled in
+
+	Returns:
+		None
+*/
+void menuScroll(MCUFRIEND_kbv* tft, int8_t dir, const char* name) {
+	if (dir > 0) {
+		for (uint8_t row = 0; row + 1 < MENU_ROWS; row++) {
+			setRow(tft, row, rows[row + 1].name, rows[row + 1].length);
+		}
+		menuSetRow(tft, MENU_ROWS - 1, name);
+	} else {
+		for (uint8_t row = MENU_ROWS - 1; row > 0; row--) {
+			setRow(tft, row, rows[row - 1].name, rows[row - 1].length);
+		}
+		menuSetRow(tft, 0, name);
+	}
+}
@@ -0,0 +1,47 @@
+/*
+	The restaurant menu: a page of names in rows down the display at text
+	size 2, one of them highlighted. The names on the display are kept in
+	memory, so moving the highlight or scrolling the list by a row redraws
+	only the characters that change, without reading the card again. Text is
+	sent a scanline at a time through one address window, from bitmaps of
+	the glyphs cached as they are first drawn, rather than as a rectangle
+	for every dot of every character.
+
+	Each row is drawn as text printed at size 2 would be, in the same order
+	from the top, so the display looks the same as printing the page.
+*/
+
+#ifndef _MENU_H_
+#define _MENU_H_
+
+#include <Arduino.h>
+#include <MCUFRIEND_kbv.h>
+#include "restaurant.h"
+
+// rows of the menu, and characters of a name that fit across the display
+#define MENU_ROWS REST_PAGE_SIZE
+#define MENU_COLS 40
+
+// Pixels from one row to the next. The text is 16 pixels high, so the last
+// line of each row is shared with the first of the row below.
+#define MENU_PITCH 15
+
+// glyphs of the font kept as bitmaps, each in the slot its code picks
+#define GLYPH_SLOTS 16
+
+// Forget the rows, as when the display has been cleared to black, and
+// highlight the first.
+void menuClear();
+
+// Show a name in a row of the menu, redrawing the characters that change.
+void menuSetRow(MCUFRIEND_kbv* tft, uint8_t row, const char* name);
+
+// Move the highlight to a row.
+void menuSelect(MCUFRIEND_kbv* tft, uint8_t row);
+
+// Scroll the rows by one, up if dir > 0 with name entering at the bottom,
+// or down if dir < 0 with name entering at the top. The highlight stays in
+// the same row.
+void menuScroll(MCUFRIEND_kbv* tft, int8_t dir, const char* name);
+
+#endif
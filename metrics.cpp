@@ -0,0 +1,152 @@
+#include "metrics.h"
+#include "yegmap.h"
+
+// Travel speed weights over the map, from the north west corner. These are
+// rough estimates: the ring road around the edge of the map is fast, while
+// downtown and the river valley, with its few crossings, are slow.
+const uint8_t travelWeights[TRAVEL_CELLS][TRAVEL_CELLS] PROGMEM = {
+	{ 12, 12, 12, 12, 12, 12, 12, 12 },
+	{ 12, 16, 16, 16, 16, 20, 24, 12 },
+	{ 12, 16, 16, 18, 20, 24, 20, 12 },
+	{ 12, 16, 18, 24, 28, 20, 16, 12 },
+	{ 12, 18, 24, 22, 16, 16, 16, 12 },
+	{ 12, 24, 20, 16, 16, 16, 16, 12 },
+	{ 12, 24, 16, 16, 16, 16, 16, 12 },
+	{ 12, 12, 12, 12, 12, 12, 12, 12 }
+};
+
+/*
+	Computes the manhattan distance between two points (x1, y1) and (x2, y2).
+
+	Argumnets:
+		x1 (int16_t): x coordinate of first point
+		x2 (int16_t): x coordinate of second point
+		y1 (int16_t): y coordinate of first point
+		y2 (int16_t): y coordinate of second point
+
+	Returns:
+		Manhattan distance betweeen the two points
+*/
+int16_t manhattan(int16_t x1, int16_t y1, int16_t x2, int16_t y2) {
+	return abs(x1-x2) + abs(y1-y2);
+}
+
+/*
+	Computes the integer square root one bit at a time, using only shifts,
+	additions and comparisons, which are cheap on the AVR.
+
+	Arguments:
+		n (uint32_t): the number to take the root of
+
+	Returns:
+		The largest r such that r*r <= n
+*/
+uint16_t isqrt(uint32_t n) {
+	uint32_t root = 0;
+	uint32_t bit = 1UL << 30;
+
+	while (bit > n) {
+		bit >>= 2;
+	}
+	while (bit != 0) {
+		if (n >= root + bit) {
+			n -= root + bit;
+			root = (root >> 1) + bit;
+		} else {
+			root >>= 1;
+		}
+		bit >>= 2;
+	}
+	return root;
+}
+
+/*
+	Computes the straight line distance between two points (x1, y1) and
+	(x2, y2). The squared distance is exact in 32 bits for any two points on
+	the map, and its root keeps the distance in the bits of a list key.
+
+	Arguments:
+		x1 (int16_t): x coordinate of first point
+		y1 (int16_t): y coordinate of first point
+		x2 (int16_t): x coordinate of second point
+		y2 (int16_t): y coordinate of second point
+
+	Returns:
+		Euclidean distance between the two points, rounded down
+*/
+uint16_t euclidean(int16_t x1, int16_t y1, int16_t x2, int16_t y2) {
+	int32_t dx = x1 - x2, dy = y1 - y2;
+	return isqrt((uint32_t) (dx*dx + dy*dy));
+}
+
+/*
+	Looks up the travel speed weight of the cell holding a point.
+
+	Arguments:
+		x (int16_t): x coordinate of the point
+		y (int16_t): y coordinate of the point
+		zoom (uint8_t): zoom level of the map the point is on
+
+	Returns:
+		Weight of the cell, TRAVEL_UNIT being normal speed
+*/
+static uint8_t travelWeight(int16_t x, int16_t y, uint8_t zoom) {
+	int16_t cx = constrain(rezoom(x, zoom, 0) >> TRAVEL_SHIFT, 0, TRAVEL_CELLS - 1);
+	int16_t cy = constrain(rezoom(y, zoom, 0) >> TRAVEL_SHIFT, 0, TRAVEL_CELLS - 1);
+	return pgm_read_byte(&travelWeights[cy][cx]);
+}
+
+/*
+	Approximates the time to travel between two points (x1, y1) and (x2, y2)
+	as the Manhattan distance along the grid of streets, weighted by the
+	average speed weight of the cells at TRAVEL_SAMPLES evenly spaced points
+	of the straight line between them.
+
+	Arguments:
+		x1 (int16_t): x coordinate of first point
+		y1 (int16_t): y coordinate of first point
+		x2 (int16_t): x coordinate of second point
+		y2 (int16_t): y coordinate of second point
+		zoom (uint8_t): zoom level of the map the points are on
+
+	Returns:
+		Distance at normal speed that takes as long to travel
+*/
+uint16_t travelTime(int16_t x1, int16_t y1, int16_t x2, int16_t y2, uint8_t zoom) {
+	int16_t dx = x2 - x1, dy = y2 - y1;
+	uint16_t weights = 0;
+
+	// the middle of each of TRAVEL_SAMPLES equal parts of the line
+	for (int k = 0; k < TRAVEL_SAMPLES; k++) {
+		int16_t part = 2*k + 1;
+		weights += travelWeight(x1 + (int32_t) dx * part / (2*TRAVEL_SAMPLES),
+														y1 + (int32_t) dy * part / (2*TRAVEL_SAMPLES), zoom);
+	}
+
+	return (uint32_t) manhattan(x1, y1, x2, y2) * weights / (TRAVEL_SAMPLES * TRAVEL_UNIT);
+}
+
+/*
+	Computes the distance between two points by the given metric.
+
+	Arguments:
+		metric (uint8_t): the DistMetric to use
+		x1 (int16_t): x coordinate of first point
+		y1 (int16_t): y coordinate of first point
+		x2 (int16_t): x coordinate of second point
+		y2 (int16_t): y coordinate of second point
+		zoom (uint8_t): zoom level of the map the points are on
+
+	Returns:
+		Distance between the two points
+*/
+uint16_t distance(uint8_t metric, int16_t x1, int16_t y1, int16_t x2, int16_t y2, uint8_t zoom) {
+	switch (metric) {
+		case EUCLIDEAN:
+			return euclidean(x1, y1, x2, y2);
+		case TRAVEL_TIME:
+			return travelTime(x1, y1, x2, y2, zoom);
+		default:
+			return manhattan(x1, y1, x2, y2);
+	}
+}
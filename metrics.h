@@ -0,0 +1,46 @@
+/*
+	Distance metrics used to order the restaurants around the cursor. All of
+	them are integer kernels cheap enough to run for every restaurant on the
+	card each time the list is built, and all of them give a distance in
+	pixels of the map at the zoom level the points are on.
+*/
+
+#ifndef _METRICS_H_
+#define _METRICS_H_
+
+#include <Arduino.h>
+
+// The metrics selectable with the metric button.
+enum DistMetric { MANHATTAN, EUCLIDEAN, TRAVEL_TIME, NUM_METRICS };
+
+// The travel time metric weights distance by a grid of TRAVEL_CELLS by
+// TRAVEL_CELLS cells over the full size map, each 1 << TRAVEL_SHIFT pixels
+// square. A weight of TRAVEL_UNIT is normal speed, less is faster.
+#define TRAVEL_SHIFT 8
+#define TRAVEL_CELLS 8
+#define TRAVEL_UNIT 16
+
+// Number of points along the way whose cells are averaged.
+#define TRAVEL_SAMPLES 4
+
+// Speed weight of each cell, by row from the north west corner.
+extern const uint8_t travelWeights[TRAVEL_CELLS][TRAVEL_CELLS] PROGMEM;
+
+// Manhattan distance between (x1, y1) and (x2, y2).
+int16_t manhattan(int16_t x1, int16_t y1, int16_t x2, int16_t y2);
+
+// Integer square root, rounded down.
+uint16_t isqrt(uint32_t n);
+
+// Straight line distance between (x1, y1) and (x2, y2), rounded down. The
+// square is computed exactly in 32 bits before the root is taken.
+uint16_t euclidean(int16_t x1, int16_t y1, int16_t x2, int16_t y2);
+
+// Approximate time to travel from (x1, y1) to (x2, y2) on the map at the
+// given zoom level, as the distance at normal speed that takes as long.
+uint16_t travelTime(int16_t x1, int16_t y1, int16_t x2, int16_t y2, uint8_t zoom);
+
+// Distance between (x1, y1) and (x2, y2) by the given DistMetric.
+uint16_t distance(uint8_t metric, int16_t x1, int16_t y1, int16_t x2, int16_t y2, uint8_t zoom);
+
+#endif
@@ -0,0 +1,190 @@
+#include "namesearch.h"
+#include "sdcard.h"
+#include "iostats.h"
+#include "trace.h"
+
+/*
+	Makes sure the given block of the card is in the cache, reading it from
+	the card if it is not (see cachedData() for where it is). Every block
+	the cache holds, of restaurants, an index or the marker table, is read
+	through here.
+
+	Arguments:
+		block (uint32_t): block of the card to read
+		retry (bool): whether a failed read is retried, see cardView()
+		card (Sd2Card*): pointer to SD card
+		cache (RestCache*): pointer to cache of restaurant structs, which holds the block
+
+	Returns:
+		true if the block is in the cache
+*/
+bool fillCache(uint32_t block, bool retry, Sd2Card* card, RestCache* cache) {
+	if (block == cache->cachedBlock) {
+		IO_COUNT(cacheHits, 1);
+		return true;
+	}
+
+	TRACE_SCOPE(TRACE_READ_BLOCK);
+	// the block is no longer the one the cache held, whether or not it is read
+	cache->cachedBlock = 0;
+	const uint8_t* data;
+	if (retry) {
+		data = cardView(card, block, (uint8_t*) cache->block);
+	}
+	else {
+		data = cardViewOnce(card, block, (uint8_t*) cache->block);
+		// cardView() counts its own commands, a single try does not
+		IO_COUNT(sdCommands, 1);
+	}
+	if (data == NULL) {
+		return false;
+	}
+	cacheHold(cache, block, data);
+	IO_COUNT(blockReads, 1);
+	IO_COUNT(bytesRead, 512);
+	IO_COUNT(cacheMisses, 1);
+	return true;
+}
+
+/*
+	Makes sure the given block of an index written after the restaurants is
+	in the cache. Unlike the blocks of restaurants, an index may be missing
+	from the card, so a failed read is not retried.
+
+	Arguments:
+		block (uint32_t): block of the card to read
+		card (Sd2Card*): pointer to SD card
+		cache (RestCache*): pointer to cache of restaurant structs, which holds the block
+
+	Returns:
+		true if the block is in the cache
+*/
+bool readIndexBlock(uint32_t block, Sd2Card* card, RestCache* cache) {
+	return fillCache(block, false, card, cache);
+}
+
+/*
+	Compares a prefix in the index with a prefix being searched for, folding
+	the latter, over the first NAME_PREFIX characters.
+
+	Arguments:
+		key (const char*): prefix in the index, padded with '\0'
+		prefix (const char*): prefix being searched for
+
+	Returns:
+		Negative, zero or positive as key is before, the same as or after prefix
+*/
+static int compareName(const char* key, const char* prefix) {
+	for (int i = 0; i < NAME_PREFIX; i++) {
+		char c = nameFold(prefix[i]);
+		if (key[i] != c) {
+			return (uint8_t) key[i] - (uint8_t) c;
+		}
+		if (c == '\0') {
+			break;
+		}
+	}
+	return 0;
+}
+
+/*
+	Finds the first entry of the name index that is not before the prefix:
+	a binary search of the first prefixes of the blocks of entries in the
+	first block of the index picks the block it is in, which is then
+	searched the same way.
+
+	Arguments:
+		prefix (const char*): the start of the name searched for
+		card (Sd2Card*): pointer to SD card
+		cache (RestCache*): pointer to cache of restaurant structs
+
+	Returns:
+		Position of the entry in the index (the number of entries if every
+		entry is before the prefix), or NAME_NO_INDEX if there is no index
+*/
+int16_t findName(const char* prefix, Sd2Card* card, RestCache* cache) {
+	if (!readIndexBlock(NAME_INDEX_BLOCK, card, cache)) {
+		return NAME_NO_INDEX;
+	}
+	const NameIndexHeader* header = (const NameIndexHeader*) cachedData(cache);
+	if (header->magic != NAME_INDEX_MAGIC || header->leaves > NAME_LEAVES) {
+		return NAME_NO_INDEX;
+	}
+	int16_t count = header->count;
+
+	// the last block whose first prefix is before the prefix, or the first
+	int lo = 0, hi = header->leaves - 1;
+	while (lo < hi) {
+		int mid = (lo + hi + 1) / 2;
+		if (compareName(header->fence[mid], prefix) < 0) {
+			lo = mid;
+		} else {
+			hi = mid - 1;
+		}
+	}
+
+	int leaf = lo;
+	if (!readIndexBlock(NAME_INDEX_BLOCK + 1 + leaf, card, cache)) {
+		return NAME_NO_INDEX;
+	}
+	const NameEntry* entries = (const NameEntry*) cachedData(cache);
+
+	// the first entry of the block not before the prefix, which is the first
+	// entry of the next block if there is none (the padding sorts last)
+	lo = 0;
+	hi = NAME_LEAF_ENTRIES;
+	while (lo < hi) {
+		int mid = (lo + hi) / 2;
+		if (entries[mid].index != NAME_UNUSED && compareName(entries[mid].prefix, prefix) < 0) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+
+	return min(leaf * NAME_LEAF_ENTRIES + lo, count);
+}
+
+/*
+	Sets *e to the entry at the given position of the name index.
+
+	Arguments:
+		e (NameEntry*): pointer to the entry
+		pos (int16_t): position of the entry in the index
+		card (Sd2Card*): pointer to SD card
+		cache (RestCache*): pointer to cache of restaurant structs
+
+	Returns:
+		false if there is no entry at the position
+*/
+bool getNameEntry(NameEntry* e, int16_t pos, Sd2Card* card, RestCache* cache) {
+	if (pos < 0 || pos >= NAME_LEAVES * NAME_LEAF_ENTRIES) {
+		return false;
+	}
+	if (!readIndexBlock(NAME_INDEX_BLOCK + 1 + pos / NAME_LEAF_ENTRIES, card, cache)) {
+		return false;
+	}
+
+	*e = ((const NameEntry*) cachedData(cache))[pos % NAME_LEAF_ENTRIES];
+	return e->index != NAME_UNUSED;
+}
+
+/*
+	Checks whether the name of an entry of the index starts with a prefix.
+	Only the first NAME_PREFIX characters of the prefix are compared.
+
+	Arguments:
+		e (const NameEntry&): pass-by-reference to the entry
+		prefix (const char*): the start of the name searched for
+
+	Returns:
+		true if the name starts with the prefix
+*/
+bool nameMatches(const NameEntry& e, const char* prefix) {
+	for (int i = 0; i < NAME_PREFIX && prefix[i] != '\0'; i++) {
+		if (e.prefix[i] != nameFold(prefix[i])) {
+			return false;
+		}
+	}
+	return true;
+}
@@ -0,0 +1,84 @@
+/*
+	Search for restaurants by name through an index on the card, written
+	after the restaurants by host/nameindex. The index holds the first
+	NAME_PREFIX characters of every name, folded to upper case, with the
+	index of its restaurant, sorted by prefix and then by index (so by rank
+	on a ranked card). Its first block holds the first prefix of each block
+	of entries after it, so finding the first name starting with a prefix
+	reads two blocks: that one, and the block of entries it points to.
+*/
+
+#ifndef _NAMESEARCH_H_
+#define _NAMESEARCH_H_
+
+#include <Arduino.h>
+#include <SD.h>
+#include "restaurant.h"
+
+// The index starts at the first block after the restaurants.
+#define NAME_INDEX_BLOCK (REST_START_BLOCK + (NUM_RESTAURANTS + 7) / 8)
+
+// "NIDX" as a little-endian integer, the start of the first block.
+#define NAME_INDEX_MAGIC 0x5844494EUL
+
+// Characters of each name kept in the index.
+#define NAME_PREFIX 14
+
+// Entries in each block of entries, and the number of those blocks.
+#define NAME_LEAF_ENTRIES 32
+#define NAME_LEAVES ((NUM_RESTAURANTS + NAME_LEAF_ENTRIES - 1) / NAME_LEAF_ENTRIES)
+
+// Position findName() returns when the card has no index.
+#define NAME_NO_INDEX -1
+
+// Index of the restaurant of the entries padding out the last block.
+#define NAME_UNUSED 0xFFFF
+
+// An entry of the index. The prefix is padded with '\0'.
+struct NameEntry {
+  char prefix[NAME_PREFIX];
+  uint16_t index;
+};
+
+// The first block of the index.
+struct NameIndexHeader {
+  uint32_t magic;
+  uint16_t count;                        // number of entries
+  uint16_t leaves;                       // number of blocks of entries
+  char fence[NAME_LEAVES][NAME_PREFIX];  // first prefix of each block of entries
+};
+
+#if 8 + NAME_LEAVES * NAME_PREFIX > 512
+#error "the first prefix of each block of the name index does not fit in a block"
+#endif
+
+// The character a name is folded to in the index.
+inline char nameFold(char c) {
+  return toupper(c);
+}
+
+// Position in the index of the first entry not before the prefix, which is
+// folded as it is compared, or NAME_NO_INDEX if the card has no index.
+// Reads the index through the cache of getRestaurant(), so it takes the
+// place of the block of restaurants held there.
+// Assumes *card has been initialized for raw reads.
+int16_t findName(const char* prefix, Sd2Card* card, RestCache* cache);
+
+// Get the entry at the given position of the index, returning false past
+// the last entry.
+bool getNameEntry(NameEntry* e, int16_t pos, Sd2Card* card, RestCache* cache);
+
+// Make sure a block of the card is in the cache, reading it if it is not,
+// and returning false if it could not be read. With retry a failed read is
+// tried again as cardView() does.
+bool fillCache(uint32_t block, bool retry, Sd2Card* card, RestCache* cache);
+
+// Make sure a block of an index written after the restaurants (this one, or
+// the near table of neartable.h) is in the cache, returning false if it
+// could not be read. Failed reads are not retried.
+bool readIndexBlock(uint32_t block, Sd2Card* card, RestCache* cache);
+
+// Returns true if the name of the entry starts with the prefix.
+bool nameMatches(const NameEntry& e, const char* prefix);
+
+#endif
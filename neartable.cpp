@@ -0,0 +1,52 @@
+#include "neartable.h"
+
+/*
+	Passes the restaurants of the set of the near table for the cell of the
+	cursor to a visitor. The set is in the first block of its slot, and the
+	second if it does not fit in the first.
+
+	Arguments:
+		mv (const MapView&): pass-by-reference to current map view
+		rateSelect (int): minimum rating of restaurant desired
+		metric (int): DistMetric the list is ordered by
+		visit (NearVisitor): called with each restaurant of the set
+		ctx (void*): passed on to the visitor
+		card (Sd2Card*): pointer to SD card
+		cache (RestCache*): pointer to cache of restaurant structs, which holds the blocks
+
+	Returns:
+		Number of restaurants of the rating, or NEAR_NONE if there is no set to use
+*/
+int16_t getNearRestaurants(const MapView& mv, int rateSelect, int metric, NearVisitor visit, void* ctx,
+                           Sd2Card* card, RestCache* cache) {
+	if (metric != MANHATTAN && metric != EUCLIDEAN) {
+		return NEAR_NONE;
+	}
+
+	int16_t cx = rezoom(mv.mapX + mv.cursorX, mv.zoom, 0) >> NEAR_SHIFT;
+	int16_t cy = rezoom(mv.mapY + mv.cursorY, mv.zoom, 0) >> NEAR_SHIFT;
+	uint32_t block = NEAR_TABLE_BLOCK + (uint32_t) nearSlot(cx, cy, constrain(rateSelect, 1, NEAR_RATINGS)) * NEAR_SLOT_BLOCKS;
+
+	uint16_t count = 0, total = 0;
+	for (uint8_t k = 0; k < NEAR_SLOT_BLOCKS && (k == 0 || k * NEAR_BLOCK_ENTRIES < count); k++) {
+		if (!readIndexBlock(block + k, card, cache)) {
+			return NEAR_NONE;
+		}
+		const NearBlock* b = (const NearBlock*) cachedData(cache);
+		if (b->magic != NEAR_TABLE_MAGIC) {
+			return NEAR_NONE;
+		}
+		if (k == 0) {
+			count = b->count;
+			total = b->total;
+			if (count > NEAR_SLOT_ENTRIES || total > NUM_RESTAURANTS) {
+				return NEAR_NONE;
+			}
+		}
+
+		for (uint8_t j = 0; j < NEAR_BLOCK_ENTRIES && k * NEAR_BLOCK_ENTRIES + j < count; j++) {
+			visit(b->entry[j], ctx);
+		}
+	}
+	return total;
+}
@@ -0,0 +1,85 @@
+/*
+	Table of the restaurants near each cell of the map, written after the
+	name index by host/neartable. The full size map is divided into cells
+	NEAR_CELL pixels square, and for each cell and minimum rating the table
+	holds a set of restaurants that contains the REST_PAGE_SIZE closest to
+	any point of the cell, at every zoom level, by Manhattan or Euclidean
+	distance. The first page of the list is then found by reading one or two
+	blocks and selecting from a few dozen restaurants, before the card is
+	scanned for the rest of the list.
+
+	Travel time is not bounded by how far a point is across a cell, so lists
+	by travel time are built by scanning the card alone.
+*/
+
+#ifndef _NEARTABLE_H_
+#define _NEARTABLE_H_
+
+#include <Arduino.h>
+#include <SD.h>
+#include "restaurant.h"
+#include "namesearch.h"
+#include "metrics.h"
+#include "yegmap.h"
+
+// The table starts at the first block after the name index.
+#define NEAR_TABLE_BLOCK (NAME_INDEX_BLOCK + 1 + NAME_LEAVES)
+
+// "NEAR" as a little-endian integer, the start of every block.
+#define NEAR_TABLE_MAGIC 0x5241454EUL
+
+// Cells are NEAR_CELL pixels square on the full size map.
+#define NEAR_SHIFT 6
+#define NEAR_CELL  (1 << NEAR_SHIFT)
+#define NEAR_CELLS (MAPWIDTH >> NEAR_SHIFT)
+
+// Minimum ratings there are sets for, 1 to NEAR_RATINGS stars.
+#define NEAR_RATINGS 5
+
+// Each set has a slot of NEAR_SLOT_BLOCKS blocks, of NEAR_BLOCK_ENTRIES
+// restaurants each.
+#define NEAR_SLOT_BLOCKS   2
+#define NEAR_BLOCK_ENTRIES 42
+#define NEAR_SLOT_ENTRIES  (NEAR_SLOT_BLOCKS * NEAR_BLOCK_ENTRIES)
+
+// Count of a set with more restaurants than fit in its slot.
+#define NEAR_OVERFLOW 0xFFFF
+
+// What getNearRestaurants() returns when there is no set to use.
+#define NEAR_NONE -1
+
+// A restaurant of a set, with its position as it is on the card.
+struct NearEntry {
+  int32_t lat;
+  int32_t lon;
+  uint16_t index;
+  uint16_t unused; // keeps the entry 12 bytes on the host as on the Mega
+};
+
+// A block of a slot. Every block of a slot has the same header.
+struct NearBlock {
+  uint32_t magic;
+  uint16_t count;  // restaurants in the set, or NEAR_OVERFLOW
+  uint16_t total;  // restaurants on the card of the rating
+  NearEntry entry[NEAR_BLOCK_ENTRIES];
+};
+
+// The slot of the set for the cell at (cx, cy) and the minimum rating.
+inline uint16_t nearSlot(int16_t cx, int16_t cy, int rating) {
+  return ((rating - 1) * NEAR_CELLS + cy) * NEAR_CELLS + cx;
+}
+
+// Called with each restaurant of a set by getNearRestaurants().
+typedef void (*NearVisitor)(const NearEntry& e, void* ctx);
+
+// Pass each restaurant of the set for the cell the cursor of the map view
+// is in, by the rating and DistMetric given, to visit. Returns the number
+// of restaurants of the rating on the card, or NEAR_NONE if there is no set
+// to use (no table, a full slot, travel time, or a failed read), in which
+// case whatever was visited must be thrown away.
+// Reads the table through the cache of getRestaurant().
+// Assumes *card has been initialized for raw reads.
+int16_t getNearRestaurants(const MapView& mv, int rateSelect, int metric, NearVisitor visit, void* ctx,
+                           Sd2Card* card, RestCache* cache);
+
+#endif
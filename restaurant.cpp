@@ -1,10 +1,29 @@
 #include "restaurant.h"
+#include "neartable.h"
+#include "namesearch.h"
+#include "sdcard.h"
+#include "sdstream.h"
+#include "iostats.h"
+#include "trace.h"
+
+#ifdef SORT_STATS
+SortStats sortStats;
+#define SORT_COUNT(field) (sortStats.field++)
+#define SORT_DEPTH(d) if ((d) > sortStats.maxDepth) sortStats.maxDepth = (d)
+#else
+#define SORT_COUNT(field)
+#define SORT_DEPTH(d)
+#endif
 
 /*
-	Sets *ptr to the i'th restaurant. If this restaurant is already in the cache,
-	it just copies it directly from the cache to *ptr. Otherwise, it fetches
-	the block containing the i'th restaurant and stores it in the cache before
-	setting *ptr to it. Taken from part1 solution.
+	Sets *ptr to the i'th restaurant. If this restaurant is already in the
+	cache, it just copies it directly from the cache to *ptr. Otherwise, it
+	fetches the block containing the i'th restaurant and stores it in the
+	cache before setting *ptr to it (on the host the cache only notes where
+	the block is in the mapped card image, see cardView()). Taken from part1
+	solution. If the block cannot be read, *ptr is set to a restaurant with
+	no name and no rating, so that a failing card shows up as blank entries
+	rather than hanging.
 
 	Arguments: 
 		ptr (restaurant*): pointer to restaurant struct
@@ -13,40 +32,161 @@
 		cache (RestCache*): pointer to cache of restaurant structs pulled from block
 
 	Returns:
-		None
+		true if the restaurant was read
 */
-void getRestaurant(restaurant* ptr, int i, Sd2Card* card, RestCache* cache) {
+bool getRestaurant(restaurant* ptr, int i, Sd2Card* card, RestCache* cache) {
+	TRACE_SCOPE(TRACE_GET_RESTAURANT);
+
 	// calculate the block with the i'th restaurant
 	uint32_t block = REST_START_BLOCK + i/8;
 
 	// if this is not the cached block, read the block from the card
-	if (block != cache->cachedBlock) {
-		while (!card->readBlock(block, (uint8_t*) cache->block)) {
-			Serial.print("readblock failed, try again");
-		}
-		cache->cachedBlock = block;
+	if (!fillCache(block, true, card, cache)) {
+		memset(ptr, 0, sizeof(*ptr));
+		return false;
 	}
 
 	// either way, we have the correct block so just get the restaurant
-	*ptr = cache->block[i%8];
+	*ptr = ((const restaurant*) cachedData(cache))[i%8];
+	return true;
+}
+
+// A run of restaurants being passed to a visitor by getRestaurants().
+struct RestBatch {
+	int next, end;
+	RestVisitor visit;
+	void* ctx;
+	RestCache* cache;
+};
+
+/*
+	Passes the restaurants of the batch in a block that has just been read
+	into the cache to the visitor of the batch, counting the first as a
+	cache miss and the rest as hits as getRestaurant() would.
+
+	Arguments:
+		block (uint32_t): the block read
+		data (uint8_t*): the block, which is the block of the cache
+		ctx (void*): pointer to the RestBatch
+
+	Returns:
+		true, to read the rest of the batch
+*/
+static bool visitBlock(uint32_t block, uint8_t* data, void* ctx) {
+	RestBatch* b = (RestBatch*) ctx;
+#ifdef IO_STATS
+	int first = b->next;
+#endif
+	cacheHold(b->cache, block, data);
+
+	while (b->next < b->end && (uint32_t) (REST_START_BLOCK + b->next/8) == block) {
+		b->visit(((const restaurant*) data)[b->next % 8], b->next, b->ctx);
+		b->next++;
+	}
+	IO_COUNT(cacheMisses, 1);
+	IO_COUNT(cacheHits, b->next - first - 1);
+	return true;
+}
+
+/*
+	Passes the restaurants first .. first+count-1 to a visitor in order. The
+	blocks holding them are read into the cache with one streaming read, so
+	the card is sent two commands for the batch instead of one per block.
+	If the card fails the stream, the rest are read a block at a time, with
+	the retries of getRestaurant().
+
+	Arguments:
+		first (int): index of the first restaurant
+		count (int): number of restaurants
+		visit (RestVisitor): called with each restaurant and its index
+		ctx (void*): passed on to the visitor
+		card (Sd2Card*): pointer to SD card
+		cache (RestCache*): pointer to cache of restaurant structs
+
+	Returns:
+		None
+*/
+void getRestaurants(int first, int count, RestVisitor visit, void* ctx, Sd2Card* card, RestCache* cache) {
+	RestBatch b = { first, first + count, visit, ctx, cache };
+
+	// the restaurants in the block already cached need no read
+	while (b.next < b.end && (uint32_t) (REST_START_BLOCK + b.next/8) == cache->cachedBlock) {
+		IO_COUNT(cacheHits, 1);
+		visit(((const restaurant*) cachedData(cache))[b.next % 8], b.next, ctx);
+		b.next++;
+	}
+	if (b.next == b.end) {
+		return;
+	}
+
+	uint32_t block = REST_START_BLOCK + b.next/8;
+	uint16_t blocks = (b.end - 1)/8 - b.next/8 + 1;
+	bool streamed;
+	{
+		TRACE_SCOPE(TRACE_READ_BLOCK);
+		// the cache is overwritten before it is known which block it holds
+		cache->cachedBlock = 0;
+		streamed = streamBlocks(card, block, blocks, (uint8_t*) cache->block, visitBlock, &b);
+	}
+
+	if (!streamed) {
+		restaurant r;
+		for (; b.next < b.end; b.next++) {
+			getRestaurant(&r, b.next, card, cache);
+			visit(r, b.next, ctx);
+		}
+	}
+}
+
+/*
+	Converts the 0 to 10 rating stored on the card to the 1 to 5 star scale
+	used by the rating selector.
+
+	Arguments:
+		r (const restaurant&): pass-by-reference to the restaurant
+
+	Returns:
+		Star rating of the restaurant
+*/
+int starRating(const restaurant& r) {
+	return max((r.rating + 1)/2, 1);
 }
 
 /*
 	Swaps the two restaurants (which is why they are pass by reference). Taken from part1 solution.
 
 	Arguments:
-		r1 (RestDist&): pass-by-reference to first restaurant struct
-		r2 (RestDist&): pass-by-reference to second restaurant struct
+		r1 (RestDist&): pass-by-reference to key of first restaurant
+		r2 (RestDist&): pass-by-reference to key of second restaurant
 
 	Returns:
 		None
 */
 void swap(RestDist& r1, RestDist& r2) {
+	SORT_COUNT(swaps);
 	RestDist tmp = r1;
 	r1 = r2;
 	r2 = tmp;
 }
 
+/*
+	Compares two restaurants by their distance to the cursor, ties going to
+	the lower index, which is the better rank on a ranked card. This is a
+	single comparison of their keys. All the sort engines order the list
+	through this function.
+
+	Arguments:
+		r1 (const RestDist&): pass-by-reference to key of first restaurant
+		r2 (const RestDist&): pass-by-reference to key of second restaurant
+
+	Returns:
+		true if r1 comes strictly before r2 in the sorted list
+*/
+bool closer(const RestDist& r1, const RestDist& r2) {
+	SORT_COUNT(compares);
+	return r1 < r2;
+}
+
 /*
 	Insertion sort to sort the restaurants.
 
@@ -64,7 +204,7 @@ void insertionSort(RestDist restaurants[], int n) {
 	for (int i = 1; i < n; ++i) {
 		// Swap restaurant[i] back through the sorted list restaurants[0 .. i-1]
 		// until it finds its place.
-		for (int j = i; j > 0 && restaurants[j].dist < restaurants[j-1].dist; --j) {
+		for (int j = i; j > 0 && closer(restaurants[j], restaurants[j-1]); --j) {
 			swap(restaurants[j-1], restaurants[j]);
 		}
 	}
@@ -82,11 +222,11 @@ void insertionSort(RestDist restaurants[], int n) {
 		i+1, which is the index of the pivot after the list has been sorted.
 */
 int pivot(RestDist restaurants[], int start, int end) {
-	int pi = restaurants[end].dist;
+	RestDist pi = restaurants[end];
 	int i = (start - 1);
 
 	for (int j = start; j <= end - 1; j++) {
-		if (restaurants[j].dist <= pi) {
+		if (!closer(pi, restaurants[j])) {
 			i++;
 			swap(restaurants[i], restaurants[j]);
 		}
@@ -109,56 +249,400 @@ int pivot(RestDist restaurants[], int start, int end) {
 */
 void quickSort(RestDist restaurants[], int start, int end) {
 	if (start < end) {
+#ifdef SORT_STATS
+		sortStats.depth++;
+		SORT_DEPTH(sortStats.depth);
+#endif
 		int pi = pivot(restaurants, start, end);
 		quickSort(restaurants, start, pi - 1);
 		quickSort(restaurants, pi + 1, end);
+#ifdef SORT_STATS
+		sortStats.depth--;
+#endif
 	}
 }
 
 /*
-	Computes the manhattan distance between two points (x1, y1) and (x2, y2).
+	Prepares a list build around the cursor of the given map view. Nothing is
+	read from the card until the build is stepped, which starts with the set
+	of the near table for the cursor.
 
-	Argumnets:
-		x1 (int16_t): x coordinate of first point
-		x2 (int16_t): x coordinate of second point
-		y1 (int16_t): y coordinate of first point
-		y2 (int16_t): y coordinate of second point
+	Arguments:
+		lb (ListBuild*): pointer to the list build
+		mv (const MapView&): pass-by-reference to current map view
+		rateSelect (int): minimum rating of restaurant desired
+		sortSelect (int): type of sort desired
+		metric (int): DistMetric to measure distances by
 
 	Returns:
-		Manhattan distance betweeen the two points
+		None
 */
-int16_t manhattan(int16_t x1, int16_t y1, int16_t x2, int16_t y2) {
-	return abs(x1-x2) + abs(y1-y2);
+void startList(ListBuild* lb, const MapView& mv, int rateSelect, int sortSelect, int metric) {
+	lb->mv = mv;
+	lb->recs = NULL;
+	lb->rating = rateSelect;
+	lb->metric = metric;
+	lb->engine = (sortSelect == QUICK_SORT) ? QUICK_SORT : INSERTION_SORT;
+	// sort mode BOTH times insertion sort, then rescans and times quicksort
+	lb->again = (sortSelect == BOTH_SORTS);
+	lb->phase = LIST_NEAR;
+	lb->next = 0;
+	lb->count = 0;
+	lb->total = -1;
+	lb->ready = 0;
+	lb->sortTime = 0;
 }
 
-/* 
-	Generates list of restaurants based on rating
+/*
+	Makes a list build list the restaurants in memory rather than those on
+	the card. The near table is on the card, so it is not used.
 
 	Arguments:
-		rateSelect (int): desired minimum rating of restaurant
-		mv (const MapView&): pass-by-reference to current map view
-		restaurants[] (RestDist): array of RestDist structures
+		lb (ListBuild*): pointer to the list build, just started
+		recs[] (restaurant): the NUM_RESTAURANTS restaurants, in the order of the card
+
+	Returns:
+		None
+*/
+void listFromMemory(ListBuild* lb, const restaurant recs[]) {
+	lb->recs = recs;
+	lb->phase = LIST_SCAN;
+}
+
+/*
+	Makes a list build start from a first page that is already in place, as
+	the quicksort pass of sort mode BOTH does, so the near table is not read
+	and the scan skips the restaurants of the page.
+
+	Arguments:
+		lb (ListBuild*): pointer to the list build, just started
+		count (int): number of restaurants of the page, in restaurants[0 .. count-1]
+		total (int): number of restaurants of the complete list
+
+	Returns:
+		None
+*/
+void listFromPage(ListBuild* lb, int count, int total) {
+	lb->count = lb->ready = count;
+	lb->total = total;
+	lb->phase = LIST_SCAN;
+}
+
+/*
+	Computes the key of a restaurant in the list of a build: its index and
+	its distance to the cursor by the metric of the build, in pixels of the
+	map at the zoom level of the map view.
+
+	Arguments:
+		lb (const ListBuild*): pointer to the list build
+		i (int): index of the restaurant
+		lat (int32_t): latitude of the restaurant
+		lon (int32_t): longitude of the restaurant
+
+	Returns:
+		The key of the restaurant
+*/
+static RestDist listKey(const ListBuild* lb, int i, int32_t lat, int32_t lon) {
+	const MapView& mv = lb->mv;
+	return restKey(i, distance(lb->metric, lon_to_x(lon, mv.zoom), lat_to_y(lat, mv.zoom),
+				   mv.mapX + mv.cursorX, mv.mapY + mv.cursorY, mv.zoom));
+}
+
+// The list being scanned into by scanRestaurant().
+struct ListScan {
+	ListBuild* lb;
+	RestDist* restaurants;
+};
+
+/*
+	Appends the RestDist of the next restaurant of the scan to the list if it
+	has the desired rating. Restaurants already in the final part of the
+	list (from the near table or an earlier pass) are skipped.
+
+	Arguments:
+		r (const restaurant&): pass-by-reference to the restaurant
+		i (int): index of the restaurant
+		ctx (void*): pointer to the ListScan
+
+	Returns:
+		None
+*/
+static void scanRestaurant(const restaurant& r, int i, void* ctx) {
+	ListBuild* lb = ((ListScan*) ctx)->lb;
+	RestDist* restaurants = ((ListScan*) ctx)->restaurants;
+
+	lb->next = i + 1;
+	if (starRating(r) < lb->rating) {
+		return;
+	}
+
+	for (int k = 0; k < lb->ready; k++) {
+		if (restIndex(restaurants[k]) == (RestIndex) i) {
+			return;
+		}
+	}
+
+	restaurants[lb->count] = listKey(lb, i, r.lat, r.lon);
+	lb->count++;
+}
+
+/*
+	Appends the RestDist of a restaurant of the set of the near table to the
+	list. The set only holds restaurants of the desired rating.
+
+	Arguments:
+		e (const NearEntry&): pass-by-reference to the restaurant of the set
+		ctx (void*): pointer to the ListScan
+
+	Returns:
+		None
+*/
+static void nearRestaurant(const NearEntry& e, void* ctx) {
+	ListBuild* lb = ((ListScan*) ctx)->lb;
+	RestDist* restaurants = ((ListScan*) ctx)->restaurants;
+
+	if (lb->count < NUM_RESTAURANTS) {
+		restaurants[lb->count] = listKey(lb, e.index, e.lat, e.lon);
+		lb->count++;
+	}
+}
+
+/*
+	Moves the closest restaurant of restaurants[ready .. count-1] to the
+	front of that range, so one more restaurant is in its final place.
+	Repeating this for the first page is a bounded top-K pass, which is
+	much cheaper than sorting everything before the page can be shown.
+
+	Arguments:
+		lb (ListBuild*): pointer to the list build
+		restaurants[] (RestDist): array of RestDist structs
+
+	Returns:
+		None
+*/
+void selectRestaurant(ListBuild* lb, RestDist restaurants[]) {
+	int best = lb->ready;
+	for (int j = lb->ready + 1; j < lb->count; j++) {
+		if (closer(restaurants[j], restaurants[best])) {
+			best = j;
+		}
+	}
+	swap(restaurants[lb->ready], restaurants[best]);
+	lb->ready++;
+}
+
+/*
+	Prepares the sort engine of the current pass to sort the part of the
+	list that is not in its final order yet.
+
+	Arguments:
+		lb (ListBuild*): pointer to the list build
+
+	Returns:
+		None
+*/
+void startSort(ListBuild* lb) {
+	lb->phase = LIST_SORT;
+	lb->sorted = lb->ready + 1;
+	lb->depth = 0;
+	lb->sortStart = micros();
+	if (lb->count - lb->ready > 1) {
+		lb->lo[0] = lb->ready;
+		lb->hi[0] = lb->count - 1;
+		lb->depth = 1;
+	}
+}
+
+/*
+	Does one step of the sort engine of the current pass: inserts one more
+	restaurant for insertion sort, or partitions one range for quicksort.
+	Quicksort keeps its pending ranges on an explicit stack and always works
+	on the leftmost one, so everything left of it is in its final order.
+
+	Arguments:
+		lb (ListBuild*): pointer to the list build
+		restaurants[] (RestDist): array of RestDist structs
+
+	Returns:
+		true if the list is sorted, false otherwise
+*/
+bool sortStep(ListBuild* lb, RestDist restaurants[]) {
+	if (lb->engine == INSERTION_SORT) {
+		if (lb->sorted >= lb->count) {
+			lb->ready = lb->count;
+			return true;
+		}
+		// Swap restaurant[i] back through the sorted part until it finds its place.
+		for (int j = lb->sorted; j > lb->ready && closer(restaurants[j], restaurants[j-1]); --j) {
+			swap(restaurants[j-1], restaurants[j]);
+		}
+		lb->sorted++;
+		return false;
+	}
+
+	if (lb->depth == 0) {
+		lb->ready = lb->count;
+		return true;
+	}
+
+	// pop the leftmost range
+	lb->depth--;
+	int start = lb->lo[lb->depth], end = lb->hi[lb->depth];
+
+	if (lb->depth + 2 > QSORT_STACK) {
+		// out of stack, finish this range recursively
+		quickSort(restaurants, start, end);
+	} else {
+		int pi = pivot(restaurants, start, end);
+		// push the right part first so the left part is sorted first,
+		// ranges of one restaurant are already sorted
+		if (pi + 1 < end) {
+			lb->lo[lb->depth] = pi + 1;
+			lb->hi[lb->depth] = end;
+			lb->depth++;
+		}
+		if (start < pi - 1) {
+			lb->lo[lb->depth] = start;
+			lb->hi[lb->depth] = pi - 1;
+			lb->depth++;
+		}
+		SORT_DEPTH(lb->depth);
+	}
+
+	lb->ready = (lb->depth > 0) ? lb->lo[lb->depth - 1] : lb->count;
+	return lb->depth == 0;
+}
+
+/*
+	Puts the closest REST_PAGE_SIZE restaurants of the set of the near table
+	for the cursor into their final place at the front of the list, so the
+	first page is ready before the card is scanned. The scan then skips them,
+	so the list is the same as without the table. Without a set to use, the
+	list is left empty for the scan.
+
+	Arguments:
+		lb (ListBuild*): pointer to the list build
+		restaurants[] (RestDist): array of RestDist structs
 		card (Sd2Card*): pointer to SD card
 		cache (RestCache*): pointer to cache of restaurant structs
 
 	Returns:
-		Number of restaurants that fit minimum rating
+		None
 */
-int generateList(int rateSelect, const MapView& mv, RestDist restaurants[], Sd2Card* card, RestCache* cache) {
-	restaurant r;
-	int j = 0;
-	for (int i = 0; i < NUM_RESTAURANTS; i++) {
-		getRestaurant(&r, i, card, cache);
-		int newRating = max((r.rating + 1)/2, 1);
-		if (newRating >= rateSelect) {
-			restaurants[j].index = i;
-			restaurants[j].dist = manhattan(lat_to_y(r.lat), lon_to_x(r.lon),
-								mv.mapY + mv.cursorY, mv.mapX + mv.cursorX);
-			j++;
+static void nearList(ListBuild* lb, RestDist restaurants[], Sd2Card* card, RestCache* cache) {
+	ListScan scan = { lb, restaurants };
+	int16_t total = getNearRestaurants(lb->mv, lb->rating, lb->metric, nearRestaurant, &scan, card, cache);
+	if (total == NEAR_NONE) {
+		lb->count = 0;
+		return;
+	}
+
+	while (lb->ready < min(REST_PAGE_SIZE, lb->count)) {
+		selectRestaurant(lb, restaurants);
+	}
+	lb->count = lb->ready;
+	lb->total = total;
+}
+
+/*
+	Continues building the list until it is done or the time budget runs out.
+	The build takes the first page from the near table if it can, scans the
+	card, selects the closest REST_PAGE_SIZE restaurants into their final
+	place, and then sorts the rest with the selected engine. The time spent
+	sorting in each pass is printed over serial.
+
+	Arguments:
+		lb (ListBuild*): pointer to the list build
+		restaurants[] (RestDist): array of RestDist structs
+		card (Sd2Card*): pointer to SD card
+		cache (RestCache*): pointer to cache of restaurant structs
+		budget (uint16_t): milliseconds to spend, or NO_BUDGET
+
+	Returns:
+		true if the list is complete, false otherwise
+*/
+bool stepList(ListBuild* lb, RestDist restaurants[], Sd2Card* card, RestCache* cache, uint16_t budget) {
+	uint32_t start = millis();
+
+	while (lb->phase != LIST_DONE && withinBudget(start, budget)) {
+		if (lb->phase == LIST_NEAR) {
+			nearList(lb, restaurants, card, cache);
+			lb->phase = LIST_SCAN;
+		} else if (lb->phase == LIST_SCAN) {
+			if (lb->next < NUM_RESTAURANTS) {
+				ListScan scan = { lb, restaurants };
+				int chunk = min(SCAN_CHUNK, NUM_RESTAURANTS - lb->next);
+				if (lb->recs != NULL) {
+					for (int i = lb->next, end = lb->next + chunk; i < end; i++) {
+						scanRestaurant(lb->recs[i], i, &scan);
+					}
+				} else {
+					getRestaurants(lb->next, chunk, scanRestaurant, &scan, card, cache);
+				}
+			} else {
+				lb->total = lb->count;
+				lb->phase = LIST_SELECT;
+			}
+		} else if (lb->phase == LIST_SELECT) {
+			if (lb->ready < min(REST_PAGE_SIZE, lb->count)) {
+				selectRestaurant(lb, restaurants);
+			} else {
+				startSort(lb);
+			}
+		} else {
+			uint32_t time1 = micros();
+			bool sorted = sortStep(lb, restaurants);
+			lb->sortTime += micros() - time1;
+
+			if (sorted) {
+				TRACE_RECORD(TRACE_SORT, lb->sortStart, lb->sortTime);
+				if (lb->engine == QUICK_SORT) {
+					Serial.print(F("Qsort Time: "));
+				} else {
+					Serial.print(F("Isort Time: "));
+				}
+				Serial.println(lb->sortTime / 1000);
+
+				if (lb->again) {
+					// rescan the unsorted restaurants for the quicksort pass
+					lb->again = false;
+					lb->engine = QUICK_SORT;
+					lb->phase = LIST_SCAN;
+					lb->next = 0;
+					lb->count = lb->ready = min(REST_PAGE_SIZE, lb->count);
+					lb->sortTime = 0;
+				} else {
+					lb->phase = LIST_DONE;
+				}
+			}
 		}
 	}
 
-	return j;
+	return lb->phase == LIST_DONE;
+}
+
+/*
+	Checks if the first n restaurants of the list are in their final order,
+	which is also the case once the list is shorter than n and every
+	restaurant of it is in place.
+
+	Arguments:
+		lb (const ListBuild*): pointer to the list build
+		n (int): number of restaurants needed
+
+	Returns:
+		true if restaurants[0 .. n-1] can be used, false otherwise
+*/
+bool listReady(const ListBuild* lb, int n) {
+	return lb->ready >= n || lb->ready == lb->total || lb->phase == LIST_DONE;
+}
+
+/*
+	Returns the number of restaurants the complete list holds: the number of
+	the rating on the card, as the near table or the scan found it.
+*/
+int listLength(const ListBuild* lb) {
+	return lb->total;
 }
 
 /*
@@ -173,44 +657,17 @@ int generateList(int rateSelect, const MapView& mv, RestDist restaurants[], Sd2C
 		cache (RestCache*): pointer to cache of restaurant structs
 		rateSelect (int): minimum rating of restaurant desired
 		sortSelect (int): type of sort desired
+		metric (int): DistMetric to measure distances by
 
 	Returns:
 		Number of relevant restaurants based on desired rating.
 */
 int getAndSortRestaurants(const MapView& mv, RestDist restaurants[], Sd2Card* card, RestCache* cache, 
-						  int rateSelect, int sortSelect) {
-	int relevant;
-	// First get all the restaurants and store their corresponding RestDist information.
-	if (sortSelect == 0 || sortSelect == 1) {
-		relevant = generateList(rateSelect, mv, restaurants, card, cache);
-		if (sortSelect == 0) {
-			uint32_t time1 = millis();
-			quickSort(restaurants, 0, relevant);
-			uint32_t time2 = millis();
-			Serial.print("Qsort Time: ");
-			Serial.println(time2 - time1);
-		} else {
-			uint32_t time1 = millis();
-			insertionSort(restaurants, relevant);
-			uint32_t time2 = millis();
-			Serial.print("Isort Time: ");
-			Serial.println(time2 - time1);
-		}
-	} else if (sortSelect == 2) {
-		// both
-		relevant = generateList(rateSelect, mv, restaurants, card, cache);
-		uint32_t time1 = millis();
-		insertionSort(restaurants, relevant);
-		uint32_t time2 = millis();
-		Serial.print("Isort Time: ");
-		Serial.println(time2 - time1);
-		relevant = generateList(rateSelect, mv, restaurants, card, cache);
-		time1 = millis();
-		quickSort(restaurants, 0, relevant);
-		time2 = millis();
-		Serial.print("Qsort Time: ");
-		Serial.println(time2 - time1);
-	}
-
-	return relevant;
+						  int rateSelect, int sortSelect, int metric) {
+	ListBuild lb;
+
+	startList(&lb, mv, rateSelect, sortSelect, metric);
+	stepList(&lb, restaurants, card, cache, NO_BUDGET);
+
+	return lb.count;
 }
@@ -12,10 +12,23 @@
 #include <SPI.h>
 #include "restaurant.h"
 #include "yegmap.h"
+#include "metrics.h"
+#include "scheduler.h"
 
 #define REST_START_BLOCK 4000000
 #define NUM_RESTAURANTS  1066
 
+// number of restaurants on a page of the menu
+#define REST_PAGE_SIZE 21
+
+// restaurants the list build scans between checks of its time budget, read
+// from the card with one streaming read (see sdstream.h)
+#define SCAN_CHUNK 64
+
+// most ranges the resumable quicksort keeps pending before it falls back
+// to finishing a range recursively
+#define QSORT_STACK 24
+
 // The same restaurant struct we discussed in class.
 struct restaurant {
   int32_t lat;
@@ -28,25 +41,188 @@ struct restaurant {
 struct RestCache {
   uint32_t cachedBlock;
   restaurant block[8];
+#ifndef __AVR__
+  // Host only: where the cached block is, in block or else in the card
+  // image mapped into memory, so that reads need not copy it.
+  const uint8_t* view;
+#endif
+};
+
+// Note that the cache holds the given block, which is at data: block of
+// the cache, or on the host where cardView() left it.
+inline void cacheHold(RestCache* cache, uint32_t block, const uint8_t* data) {
+  cache->cachedBlock = block;
+#ifndef __AVR__
+  cache->view = data;
+#endif
+}
+
+// Where the block the cache holds is.
+inline const uint8_t* cachedData(const RestCache* cache) {
+#ifdef __AVR__
+  return (const uint8_t*) cache->block;
+#else
+  return cache->view;
+#endif
+}
+
+// Bits of a list key holding the index of the restaurant, enough for
+// NUM_RESTAURANTS. Builds for bigger datasets (the host benchmarks) set more.
+#ifndef REST_INDEX_BITS
+#define REST_INDEX_BITS 11
+#endif
+
+#if NUM_RESTAURANTS > (1L << REST_INDEX_BITS)
+#error "REST_INDEX_BITS is too small for NUM_RESTAURANTS"
+#endif
+
+// The index and "distance to cursor" of a restaurant, for the purposes of
+// loading into main memory for sorting, packed into one integer key: the
+// Manhattan distance above the index. Comparing whole keys orders by
+// distance with ties broken by index, and the sorts move one word instead
+// of a struct. No two keys are equal, so every sort engine gives the same
+// order. The card holds the restaurants in rank order (highest rating
+// first, then by name, see host/cardrank), so the index is also the rank
+// and ties are listed by rating and name without reading the card again.
+// On the Mega the key is 24 bits (13 of distance), so the list takes 3
+// bytes per restaurant instead of 4.
+#if defined(__AVR__) && REST_INDEX_BITS <= 12
+typedef __uint24 RestDist;
+#define REST_KEY_BITS 24
+#else
+typedef uint32_t RestDist;
+#define REST_KEY_BITS 32
+#endif
+
+#if REST_INDEX_BITS <= 16
+typedef uint16_t RestIndex;
+#else
+typedef uint32_t RestIndex;
+#endif
+
+#define REST_DIST_BITS (REST_KEY_BITS - REST_INDEX_BITS)
+#define REST_INDEX_MASK ((1UL << REST_INDEX_BITS) - 1)
+
+// Largest distance a key holds, longer ones are saturated to it.
+#if REST_DIST_BITS < 16
+#define REST_DIST_MAX ((1U << REST_DIST_BITS) - 1)
+#else
+#define REST_DIST_MAX 0xFFFFU
+#endif
+
+// Pack the index and distance of a restaurant into its key.
+inline RestDist restKey(RestIndex index, uint16_t dist) {
+  return ((RestDist) min(dist, REST_DIST_MAX) << REST_INDEX_BITS) | index;
+}
+
+// Index of the restaurant of a key.
+inline RestIndex restIndex(RestDist key) {
+  return key & REST_INDEX_MASK;
+}
+
+// Distance to the cursor of the restaurant of a key.
+inline uint16_t restDist(RestDist key) {
+  return key >> REST_INDEX_BITS;
+}
+
+
+// Rating of the restaurant on the 1 to 5 star scale used by the rating selector.
+int starRating(const restaurant& r);
+// The sort modes selectable with the sort button.
+enum SortMode { QUICK_SORT, INSERTION_SORT, BOTH_SORTS };
+
+// Phases of building the sorted list of restaurants.
+enum ListPhase { LIST_NEAR, LIST_SCAN, LIST_SELECT, LIST_SORT, LIST_DONE };
+
+// Progress of building the sorted list of restaurants around a cursor a
+// slice at a time, so the main loop keeps running while it is built.
+struct ListBuild {
+  MapView mv;        // cursor the list is built around
+  const restaurant* recs; // restaurants listed from memory instead of the card, or NULL
+  int8_t rating;     // minimum rating of restaurant desired
+  int8_t metric;     // DistMetric the distances are measured by
+  int8_t engine;     // sort engine of the current pass
+  bool again;        // a quicksort pass follows this one (sort mode BOTH)
+  uint8_t phase;     // ListPhase the build is in
+  int16_t next;      // next restaurant on the card to scan
+  int16_t count;     // number of restaurants in the list
+  int16_t total;     // restaurants the complete list holds, -1 until known
+  int16_t ready;     // restaurants[0 .. ready-1] are in their final order
+  int16_t sorted;    // insertion sort: next restaurant to insert
+  int8_t depth;      // quicksort: number of pending ranges
+  int16_t lo[QSORT_STACK], hi[QSORT_STACK];
+  uint32_t sortStart; // micros() when the sort of this pass started
+  uint32_t sortTime;  // microseconds spent sorting in this pass
 };
 
-// Struct to hold the index and "distance to cursor" for a restaurant,
-// for the purposes of loading into main memory for sorting.
-struct RestDist {
-  uint16_t index; // Index of restaurant from 0 to NUM_RESTAURANTS-1.
-  uint16_t dist;  // Manhatten distance to cursor position.
+#ifdef SORT_STATS
+// Work done by the sort engines, counted when built for benchmarking.
+struct SortStats {
+  uint32_t compares; // calls to closer()
+  uint32_t swaps;    // calls to swap()
+  uint16_t depth;    // current recursion depth of quickSort
+  uint16_t maxDepth; // deepest recursion, or most pending ranges of the resumable quicksort
 };
 
+extern SortStats sortStats;
+#endif
 
 // Get the i'th restaurant from the SD card and store at the pointer location.
+// Returns false, with a blank restaurant, if the card failed every retry.
+// Assumes *card has been initialized for raw reads (see sdcard.h).
+bool getRestaurant(restaurant* ptr, int i, Sd2Card* card, RestCache* cache);
+
+// Called with each restaurant of getRestaurants() and its index. The card
+// is busy streaming while it runs, so it must not read from it.
+typedef void (*RestVisitor)(const restaurant& r, int i, void* ctx);
+
+// Get restaurants first .. first+count-1 from the SD card in order, passing
+// each to visit. Their blocks are streamed through the cache.
 // Assumes *card has been initialized for raw reads.
-void getRestaurant(restaurant* ptr, int i, Sd2Card* card, RestCache* cache);
+void getRestaurants(int first, int count, RestVisitor visit, void* ctx, Sd2Card* card, RestCache* cache);
 
 // Sort the restaurants around the cursor represented by the mapview.
 // Will actually just sort the restDist array.
 // Assumes *card has been initialized for raw reads.
-// Modified from part 1 solution to include rate selection and sort selection
+// Modified from part 1 solution to include rate selection and sort selection.
+// Distances are Manhattan unless another DistMetric is given.
 int getAndSortRestaurants(const MapView& mv, RestDist restaurants[],
-                           Sd2Card* card, RestCache* cache, int rateSelect, int sortSelect);
+                           Sd2Card* card, RestCache* cache, int rateSelect, int sortSelect,
+                           int metric = MANHATTAN);
+
+// The sort engines: insertion sort of restaurants[0 .. n-1] and quicksort
+// of restaurants[start .. end], both by distance.
+void insertionSort(RestDist restaurants[], int n);
+void quickSort(RestDist restaurants[], int start, int end);
+
+// Start building the sorted list of restaurants around the cursor
+// represented by the mapview, with the same arguments as getAndSortRestaurants.
+void startList(ListBuild* lb, const MapView& mv, int rateSelect, int sortSelect,
+               int metric = MANHATTAN);
+
+// Build the list from the NUM_RESTAURANTS restaurants at recs, in the
+// order of the card, instead of reading the card (the host query service).
+// Call after startList(). The card and cache given to stepList() are then
+// not used.
+void listFromMemory(ListBuild* lb, const restaurant recs[]);
+
+// Start the list from a first page already in restaurants[0 .. count-1]
+// in its final order, of a list of total restaurants, such as a copy of
+// the first page of an earlier build around the same cursor (see
+// listcache.h). Call after startList(). The scan then skips the page.
+void listFromPage(ListBuild* lb, int count, int total);
+
+// Continue building the list for up to budget milliseconds (NO_BUDGET to
+// finish), returning true once it is complete.
+// Assumes *card has been initialized for raw reads.
+bool stepList(ListBuild* lb, RestDist restaurants[], Sd2Card* card, RestCache* cache, uint16_t budget);
+
+// Returns true once the first n restaurants of the list are in their final
+// order, or the list is shorter than that and all of it is.
+bool listReady(const ListBuild* lb, int n);
+
+// Number of restaurants the complete list holds, known once its first page
+// is ready.
+int listLength(const ListBuild* lb);
 
 #endif
@@ -0,0 +1,36 @@
+#include "scheduler.h"
+
+/*
+	Runs one pass of the scheduler: every task whose period has elapsed since
+	it last ran is run once, in order.
+
+	Arguments:
+		tasks[] (Task): array of tasks to run
+		numTasks (int): number of tasks in the array
+
+	Returns:
+		None
+*/
+void runTasks(Task tasks[], int numTasks) {
+	for (int i = 0; i < numTasks; i++) {
+		uint32_t now = millis();
+		if (tasks[i].period == 0 || now - tasks[i].lastRun >= tasks[i].period) {
+			tasks[i].lastRun = now;
+			tasks[i].run();
+		}
+	}
+}
+
+/*
+	Checks if a slice of work may keep going.
+
+	Arguments:
+		start (uint32_t): millis() when the slice started
+		budget (uint16_t): length of the slice in milliseconds, or NO_BUDGET
+
+	Returns:
+		true if the slice has time left, false otherwise
+*/
+bool withinBudget(uint32_t start, uint16_t budget) {
+	return budget == NO_BUDGET || millis() - start < budget;
+}
@@ -0,0 +1,29 @@
+/*
+	A small cooperative scheduler for the main loop. Each task does a bounded
+	slice of work when it runs, so long operations are spread over many
+	passes of the loop and input keeps being sampled in between.
+*/
+
+#ifndef _SCHEDULER_H_
+#define _SCHEDULER_H_
+
+#include <Arduino.h>
+
+// Time budget meaning "run until the work is finished".
+#define NO_BUDGET 0
+
+// A task run periodically by the main loop.
+struct Task {
+  void (*run)();    // does one slice of the task's work
+  uint16_t period;  // milliseconds between runs, 0 to run on every pass
+  uint32_t lastRun; // millis() when the task last ran
+};
+
+// Run each task that is due once, in the order they are given.
+void runTasks(Task tasks[], int numTasks);
+
+// Returns true while a slice of work started at millis() == start is still
+// within its budget of milliseconds (always true for NO_BUDGET).
+bool withinBudget(uint32_t start, uint16_t budget);
+
+#endif
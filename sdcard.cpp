@@ -0,0 +1,205 @@
+#include "sdcard.h"
+#include "iostats.h"
+
+CardErrors cardErrors;
+
+// clock of the card, as the sckRateID of Sd2Card
+static uint8_t rate = SPI_QUARTER_SPEED;
+
+// recent failed tries, see CARD_ERROR_WEIGHT
+static uint8_t errorScore;
+
+/*
+	Computes the Fletcher-16 checksum of a block, to compare reads of it.
+
+	Arguments:
+		data (const uint8_t*): the 512 bytes of the block
+
+	Returns:
+		The checksum
+*/
+static uint16_t checksum(const uint8_t* data) {
+	uint16_t a = 0, b = 0;
+	for (uint16_t i = 0; i < 512; i++) {
+		a = (a + data[i]) % 255;
+		b = (b + a) % 255;
+	}
+	return (b << 8) | a;
+}
+
+/*
+	Checks that the card reads the verification blocks back the same at its
+	current clock as they were read at the slowest one.
+
+	Arguments:
+		card (Sd2Card*): pointer to SD card
+		block (uint32_t): first of the verification blocks
+		sums (const uint16_t*): checksums of the blocks at the slowest clock
+		buf (uint8_t*): 512 bytes of scratch
+
+	Returns:
+		true if every read succeeded and matched
+*/
+static bool verify(Sd2Card* card, uint32_t block, const uint16_t* sums, uint8_t* buf) {
+	for (uint8_t pass = 0; pass < CARD_VERIFY_PASSES; pass++) {
+		for (uint8_t k = 0; k < CARD_VERIFY_BLOCKS; k++) {
+			if (!card->readBlock(block + k, buf) || checksum(buf) != sums[k]) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+/*
+	Initializes the card for raw reads at the fastest clock it reads the
+	verification blocks back correctly at, trying SPI_FULL_SPEED and then
+	each slower clock down to SPI_QUARTER_SPEED.
+
+	Arguments:
+		card (Sd2Card*): pointer to SD card
+		chipSelectPin (uint8_t): chip select pin of the card
+		verifyBlock (uint32_t): first of the blocks read back
+		buf (uint8_t*): 512 bytes of scratch
+
+	Returns:
+		false if the card did not initialize
+*/
+bool cardBegin(Sd2Card* card, uint8_t chipSelectPin, uint32_t verifyBlock, uint8_t* buf) {
+	rate = SPI_QUARTER_SPEED;
+	errorScore = 0;
+	if (!card->init(rate, chipSelectPin)) {
+		return false;
+	}
+
+	// the blocks as read at the slowest clock, which every card manages
+	uint16_t sums[CARD_VERIFY_BLOCKS];
+	for (uint8_t k = 0; k < CARD_VERIFY_BLOCKS; k++) {
+		if (!cardRead(card, verifyBlock + k, buf)) {
+			return true;
+		}
+		sums[k] = checksum(buf);
+	}
+
+	for (uint8_t r = SPI_FULL_SPEED; r < SPI_QUARTER_SPEED; r++) {
+		if (card->setSckRate(r) && verify(card, verifyBlock, sums, buf)) {
+			rate = r;
+			return true;
+		}
+	}
+	card->setSckRate(rate);
+	return true;
+}
+
+/*
+	Returns the clock of the card as the sckRateID of Sd2Card.
+*/
+uint8_t cardRate() {
+	return rate;
+}
+
+/*
+	Returns the clock of the card in Hz. Sd2Card divides the clock of the
+	CPU by 2 at SPI_FULL_SPEED, and by twice as much at each slower one.
+*/
+uint32_t cardClock() {
+	return F_CPU >> (rate + 1);
+}
+
+/*
+	Counts a failed try toward slowing the card down, and slows it down a
+	step if tries have been failing too often.
+
+	Arguments:
+		card (Sd2Card*): pointer to SD card
+
+	Returns:
+		None
+*/
+static void failed(Sd2Card* card) {
+	errorScore += CARD_ERROR_WEIGHT;
+	if (errorScore >= CARD_DROP_SCORE) {
+		errorScore = 0;
+		if (rate < SPI_QUARTER_SPEED && card->setSckRate(rate + 1)) {
+			rate++;
+			cardErrors.drops++;
+			Serial.println(F("SD reads failing, lowering the clock"));
+		}
+	}
+}
+
+/*
+	Notes a block of a stream read, or failed, counting it as cardRead()
+	counts its tries.
+
+	Arguments:
+		card (Sd2Card*): pointer to SD card
+		ok (bool): whether the block was read
+
+	Returns:
+		None
+*/
+void cardStreamed(Sd2Card* card, bool ok) {
+	if (ok) {
+		if (errorScore > 0) {
+			errorScore--;
+		}
+	} else {
+		cardErrors.retries++;
+		failed(card);
+	}
+}
+
+/*
+	Reads a block of the card, trying again after a failure, up to
+	CARD_READ_TRIES times with the wait doubling each time.
+
+	Arguments:
+		card (Sd2Card*): pointer to SD card
+		block (uint32_t): the block to read
+		dst (uint8_t*): where to put its 512 bytes
+
+	Returns:
+		true if the block was read
+*/
+bool cardRead(Sd2Card* card, uint32_t block, uint8_t* dst) {
+	const uint8_t* data = cardView(card, block, dst);
+	if (data != NULL && data != dst) {
+		memcpy(dst, data, 512);
+	}
+	return data != NULL;
+}
+
+/*
+	Reads a block of the card as cardRead() does, but leaves it where it is
+	on the host rather than copying it.
+
+	Arguments:
+		card (Sd2Card*): pointer to SD card
+		block (uint32_t): the block to read
+		dst (uint8_t*): where to put its 512 bytes, if it is copied
+
+	Returns:
+		Where the block is, or NULL if it was not read
+*/
+const uint8_t* cardView(Sd2Card* card, uint32_t block, uint8_t* dst) {
+	for (uint8_t t = 0; t < CARD_READ_TRIES; t++) {
+		if (t > 0) {
+			cardErrors.retries++;
+			delay(CARD_BACKOFF_MS << (t - 1));
+		}
+		IO_COUNT(sdCommands, 1);
+		const uint8_t* data = cardViewOnce(card, block, dst);
+		if (data != NULL) {
+			if (errorScore > 0) {
+				errorScore--;
+			}
+			return data;
+		}
+		failed(card);
+	}
+
+	cardErrors.failures++;
+	Serial.println(F("readblock failed"));
+	return NULL;
+}
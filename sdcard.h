@@ -0,0 +1,75 @@
+/*
+	Raw block reads of the SD card. The card is brought up at the fastest
+	SPI clock at which it reads a set of blocks back the same as it does at
+	a slow one, since in SPI mode the card sends no checked CRC and a clock
+	that is too fast can return bad data without an error. Reads that fail
+	are retried a bounded number of times with a growing delay, and a card
+	whose reads keep failing is slowed down rather than retried forever.
+*/
+
+#ifndef _SDCARD_H_
+#define _SDCARD_H_
+
+#include <Arduino.h>
+#include <SD.h>
+
+// Blocks read back to check a clock, and times each is read at it.
+#define CARD_VERIFY_BLOCKS 4
+#define CARD_VERIFY_PASSES 2
+
+// Tries of a block read before it fails, waiting CARD_BACKOFF_MS after the
+// first failure and twice as long after each one after that.
+#define CARD_READ_TRIES 4
+#define CARD_BACKOFF_MS 2
+
+// Every failed try adds CARD_ERROR_WEIGHT to the error score and every good
+// read takes one off. At CARD_DROP_SCORE the clock is lowered a step, so a
+// card failing more than one read in CARD_ERROR_WEIGHT is slowed down.
+#define CARD_ERROR_WEIGHT 8
+#define CARD_DROP_SCORE   32
+
+// Errors of the raw reads of the card since start up.
+struct CardErrors {
+  uint16_t retries;  // tries that failed and were tried again
+  uint16_t failures; // reads that failed every try
+  uint8_t drops;     // times the clock was lowered
+};
+
+extern CardErrors cardErrors;
+
+// Initialize the card for raw reads at the fastest clock at which the
+// CARD_VERIFY_BLOCKS blocks from verifyBlock read back the same as at
+// SPI_QUARTER_SPEED. buf is 512 bytes of scratch. Returns false if the card
+// does not initialize at all.
+bool cardBegin(Sd2Card* card, uint8_t chipSelectPin, uint32_t verifyBlock, uint8_t* buf);
+
+// The clock the card runs at, as the sckRateID of Sd2Card (SPI_FULL_SPEED
+// and slower), and in Hz.
+uint8_t cardRate();
+uint32_t cardClock();
+
+// Read a block, retrying a failed read. Returns false once the tries are
+// used up, leaving dst undefined.
+bool cardRead(Sd2Card* card, uint32_t block, uint8_t* dst);
+
+// Read a block as cardRead() does, returning where it is, or NULL once the
+// tries are used up. That is dst, except on the host, where the block is
+// left where it is in the card image mapped into memory if it can be
+// (see host/SD.h), rather than copied to dst.
+const uint8_t* cardView(Sd2Card* card, uint32_t block, uint8_t* dst);
+
+// Read a block with a single try, returning where it is as cardView() does.
+inline const uint8_t* cardViewOnce(Sd2Card* card, uint32_t block, uint8_t* dst) {
+#ifdef __AVR__
+  return card->readBlock(block, dst) ? dst : NULL;
+#else
+  return card->mapBlock(block, dst);
+#endif
+}
+
+// Note a block of a stream (see sdstream.h) read, or failed, so that
+// streams count toward slowing the card down as cardRead() does. A failed
+// stream is tried again by whoever started it.
+void cardStreamed(Sd2Card* card, bool ok);
+
+#endif
@@ -0,0 +1,415 @@
+#include "sdstream.h"
+#include "sdcard.h"
+#include "iostats.h"
+
+#ifdef __AVR__
+#include <SPI.h>
+
+// SD commands and tokens used by the stream
+#define CMD12 12              // STOP_TRANSMISSION
+#define CMD18 18              // READ_MULTIPLE_BLOCK
+#define DATA_START_BLOCK 0xFE // sent by the card before the data of a block
+
+static uint8_t streamPin;
+#else
+// The stand-in card reads whole blocks, and the stream is served from where
+// the block is in its image rather than from a copy.
+static const uint8_t* hostBlock;
+
+// time of the overlapped work not yet hidden behind the card
+static uint64_t workLeft;
+#endif
+
+static Sd2Card* streamCard;
+
+// work done while waiting on the card, see streamOverlap()
+static StreamWork work;
+static void* workCtx;
+
+// bytes of the current block still to be read, 0 before its start token
+static uint16_t blockLeft;
+
+/*
+	Sets the chip select pin of the card for the stream.
+
+	Arguments:
+		chipSelectPin (uint8_t): the pin given to card.init()
+
+	Returns:
+		None
+*/
+void streamInit(uint8_t chipSelectPin) {
+#ifdef __AVR__
+	streamPin = chipSelectPin;
+#endif
+}
+
+#ifdef __AVR__
+/*
+	Sends a byte to the card, taking a step of the overlapped work while it
+	is shifted out and the reply shifted in.
+
+	Arguments:
+		out (uint8_t): the byte to send
+
+	Returns:
+		The byte sent back by the card
+*/
+static uint8_t transfer(uint8_t out) {
+	SPDR = out;
+	if (work != NULL && !work(workCtx)) {
+		work = NULL;
+	}
+	while (!(SPSR & _BV(SPIF))) {}
+	return SPDR;
+}
+
+/*
+	Waits for the card to stop holding the data line low, as it does while
+	it is busy.
+
+	Arguments:
+		None
+
+	Returns:
+		true if the card became ready before SD_STREAM_TIMEOUT
+*/
+static bool waitReady() {
+	uint32_t start = millis();
+	while (transfer(0xFF) != 0xFF) {
+		if (millis() - start > SD_STREAM_TIMEOUT) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/*
+	Sends a command to the card and waits for its response.
+
+	Arguments:
+		cmd (uint8_t): command index
+		arg (uint32_t): argument of the command
+
+	Returns:
+		The R1 response of the card, 0 if the command was accepted
+*/
+static uint8_t command(uint8_t cmd, uint32_t arg) {
+	// a stop has to go out even while the card is sending
+	if (cmd != CMD12) {
+		waitReady();
+	}
+
+	transfer(0x40 | cmd);
+	for (int8_t s = 24; s >= 0; s -= 8) {
+		transfer(arg >> s);
+	}
+	// the CRC is only checked for the commands that set the card up
+	transfer(0xFF);
+
+	// the byte after a stop is left over from the data it interrupted
+	if (cmd == CMD12) {
+		transfer(0xFF);
+	}
+
+	uint8_t status;
+	for (uint8_t i = 0; ((status = transfer(0xFF)) & 0x80) && i != 0xFF; i++) {}
+	return status;
+}
+
+/*
+	Waits for the start of the next block of the stream.
+
+	Arguments:
+		None
+
+	Returns:
+		true if the block started before SD_STREAM_TIMEOUT
+*/
+static bool nextBlock() {
+	uint32_t start = millis();
+	uint8_t token;
+	while ((token = transfer(0xFF)) == 0xFF) {
+		if (millis() - start > SD_STREAM_TIMEOUT) {
+			return false;
+		}
+	}
+	if (token != DATA_START_BLOCK) {
+		return false;
+	}
+	blockLeft = 512;
+	return true;
+}
+
+/*
+	Reads bytes of the current block, then its CRC once it is done.
+
+	Arguments:
+		dst (uint8_t*): where to put the bytes, or NULL to skip them
+		n (uint16_t): number of bytes, at most the rest of the block
+
+	Returns:
+		None
+*/
+static void readBytes(uint8_t* dst, uint16_t n) {
+	for (uint16_t i = 0; i < n; i++) {
+		uint8_t b = transfer(0xFF);
+		if (dst != NULL) {
+			dst[i] = b;
+		}
+	}
+	blockLeft -= n;
+	if (blockLeft == 0) {
+		transfer(0xFF);
+		transfer(0xFF);
+	}
+}
+#else
+/*
+	The stand-in runs the overlapped work all at once before the stream next
+	touches the card or the buffer, in a lane of the clock of its own (see
+	Arduino.h), and charges only the part of it that outlasts the card.
+*/
+static void runWork() {
+	if (work != NULL) {
+		hostLaneBegin();
+		while (work(workCtx)) {}
+		workLeft += hostLaneEnd();
+		work = NULL;
+	}
+}
+
+static void opBegin() {
+	runWork();
+	hostLaneBegin();
+}
+
+static void opEnd() {
+	uint64_t nanos = hostLaneEnd();
+	hostCharge(nanos);
+	workLeft -= min(nanos, workLeft);
+}
+
+static bool nextBlock() {
+	opBegin();
+	hostBlock = streamCard->mapData();
+	opEnd();
+	if (hostBlock == NULL) {
+		return false;
+	}
+	blockLeft = 512;
+	return true;
+}
+
+static void readBytes(uint8_t* dst, uint16_t n) {
+	// the work may still need what dst holds
+	runWork();
+	if (dst != NULL) {
+		memcpy(dst, hostBlock + 512 - blockLeft, n);
+	}
+	blockLeft -= n;
+}
+#endif
+
+/*
+	Starts a multi-block read of the card.
+
+	Arguments:
+		card (Sd2Card*): pointer to SD card
+		block (uint32_t): first block to read
+
+	Returns:
+		true if the card accepted the read
+*/
+bool streamStart(Sd2Card* card, uint32_t block) {
+	streamCard = card;
+	blockLeft = 0;
+	IO_COUNT(sdCommands, 1);
+
+#ifdef __AVR__
+	SPI.beginTransaction(SPISettings(cardClock(), MSBFIRST, SPI_MODE0));
+	digitalWrite(streamPin, LOW);
+
+	// standard capacity cards are addressed by byte rather than by block
+	if (card->type() != SD_CARD_TYPE_SDHC) {
+		block <<= 9;
+	}
+	bool ok = command(CMD18, block) == 0;
+	if (!ok) {
+		digitalWrite(streamPin, HIGH);
+		SPI.endTransaction();
+	}
+#else
+	opBegin();
+	bool ok = card->readStart(block);
+	opEnd();
+#endif
+	if (!ok) {
+		cardStreamed(card, false);
+	}
+	return ok;
+}
+
+/*
+	Reads the next bytes of the stream, starting the blocks they are in as
+	they are reached.
+
+	Arguments:
+		dst (uint8_t*): where to put the bytes, or NULL to skip them
+		n (uint32_t): number of bytes
+
+	Returns:
+		true if every byte was read
+*/
+bool streamRead(uint8_t* dst, uint32_t n) {
+	while (n > 0) {
+		if (blockLeft == 0) {
+			bool ok = nextBlock();
+			cardStreamed(streamCard, ok);
+			if (!ok) {
+				return false;
+			}
+			IO_COUNT(blockReads, 1);
+		}
+		uint16_t part = min(n, (uint32_t) blockLeft);
+		readBytes(dst, part);
+		IO_COUNT(bytesRead, part);
+		if (dst != NULL) {
+			dst += part;
+		}
+		n -= part;
+	}
+	return true;
+}
+
+/*
+	Stops the stream, leaving the card free for other reads.
+
+	Arguments:
+		None
+
+	Returns:
+		None
+*/
+void streamStop() {
+	IO_COUNT(sdCommands, 1);
+
+#ifdef __AVR__
+	command(CMD12, 0);
+	waitReady();
+	digitalWrite(streamPin, HIGH);
+	SPI.endTransaction();
+#else
+	opBegin();
+	streamCard->readStop();
+	opEnd();
+#endif
+}
+
+/*
+	Gives the stream work to do while it waits on the card, finishing any
+	it was given before.
+
+	Arguments:
+		w (StreamWork): called for each step of the work
+		ctx (void*): passed on to w
+
+	Returns:
+		None
+*/
+void streamOverlap(StreamWork w, void* ctx) {
+	streamOverlapFinish();
+	work = w;
+	workCtx = ctx;
+}
+
+/*
+	Finishes the work given to streamOverlap(), if any is left.
+
+	Arguments:
+		None
+
+	Returns:
+		None
+*/
+void streamOverlapFinish() {
+#ifdef __AVR__
+	while (work != NULL && work(workCtx)) {}
+	work = NULL;
+#else
+	runWork();
+	hostCharge(workLeft);
+	workLeft = 0;
+#endif
+}
+
+/*
+	Reads a run of blocks with one stream, passing each to a sink as it
+	arrives.
+
+	Arguments:
+		card (Sd2Card*): pointer to SD card
+		block (uint32_t): first block to read
+		count (uint16_t): number of blocks
+		buf (uint8_t*): 512 byte buffer each block is read into
+		sink (BlockSink): called with each block, returns false to stop
+		ctx (void*): passed on to the sink
+
+	Returns:
+		false if the card failed
+*/
+bool streamBlocks(Sd2Card* card, uint32_t block, uint16_t count, uint8_t* buf,
+                  BlockSink sink, void* ctx) {
+	if (!streamStart(card, block)) {
+		return false;
+	}
+
+	bool ok = true;
+	for (uint16_t k = 0; k < count; k++) {
+		if (!streamRead(buf, 512)) {
+			ok = false;
+			break;
+		}
+		if (!sink(block + k, buf, ctx)) {
+			break;
+		}
+	}
+
+	streamStop();
+	return ok;
+}
+
+/*
+	Finds the blocks of a file in the root directory of the card. Files
+	copied onto a freshly formatted card are in consecutive blocks. The
+	volume opened here rebinds the volume cache of the SD library to card,
+	so this is only done before SD.begin() (see sdstream.h).
+
+	Arguments:
+		card (Sd2Card*): pointer to SD card
+		name (const char*): name of the file
+		first (uint32_t*): set to the first block of the file
+		count (uint32_t*): set to the number of blocks of the file
+
+	Returns:
+		true if the file was found in consecutive blocks
+*/
+bool streamLocate(Sd2Card* card, const char* name, uint32_t* first, uint32_t* count) {
+#ifdef __AVR__
+	SdVolume volume;
+	SdFile root, file;
+	uint32_t last;
+
+	if (!volume.init(card) || !root.openRoot(&volume) || !file.open(&root, name, O_READ)) {
+		return false;
+	}
+	bool contiguous = file.contiguousRange(first, &last);
+	file.close();
+	root.close();
+
+	*count = last - *first + 1;
+	return contiguous;
+#else
+	return card->locate(name, first, count);
+#endif
+}
@@ -0,0 +1,72 @@
+/*
+	Streaming reads from the SD card. A run of consecutive blocks is read
+	with one multi-block read command (CMD18) and stopped with CMD12, rather
+	than with a single block read command (CMD17) for every block, so the
+	command and the wait for the card to respond are paid once per run
+	instead of every 512 bytes. The SD library only does single block reads,
+	so on the Mega the stream talks to the card over SPI itself.
+
+	While the stream waits on the card, the CPU can be given other work to
+	do in small steps, such as sending pixels to the display.
+
+	Only one stream is open at a time, and nothing else may use the card
+	until it is stopped.
+*/
+
+#ifndef _SDSTREAM_H_
+#define _SDSTREAM_H_
+
+#include <Arduino.h>
+#include <SD.h>
+
+// Milliseconds to wait for the card to send a block, or to finish stopping.
+#define SD_STREAM_TIMEOUT 300
+
+// Called with each block of streamBlocks() as it is read. Returns false to
+// stop the stream early.
+typedef bool (*BlockSink)(uint32_t block, uint8_t* data, void* ctx);
+
+// Work for the CPU to do while the card is busy, a small step at a time.
+// Returns false once there is nothing left to do.
+typedef bool (*StreamWork)(void* ctx);
+
+// Set the chip select pin of the card, as given to card.init().
+void streamInit(uint8_t chipSelectPin);
+
+// Start streaming from the given block, returning false if the card failed.
+// Assumes *card has been initialized for raw reads, and streams at the
+// clock chosen for it (see sdcard.h).
+bool streamStart(Sd2Card* card, uint32_t block);
+
+// Read the next n bytes of the stream into dst, or skip them if dst is
+// NULL, crossing into the following blocks as needed.
+bool streamRead(uint8_t* dst, uint32_t n);
+
+// Stop the stream, even part way through a block.
+void streamStop();
+
+// Do work while the stream waits on the card: on the Mega a step of it
+// runs while each byte is shifted over SPI, and a step is taken for every
+// byte until the work is done. Any work from an earlier call is finished
+// first.
+void streamOverlap(StreamWork work, void* ctx);
+
+// Finish the work given to streamOverlap(), if any is left.
+void streamOverlapFinish();
+
+// Read count blocks from the given block into buf (512 bytes), calling
+// sink with each. Returns false if the card failed, in which case the
+// caller can fall back to readBlock().
+bool streamBlocks(Sd2Card* card, uint32_t block, uint16_t count, uint8_t* buf,
+                  BlockSink sink, void* ctx);
+
+// Find the first block and number of blocks of a file in the root
+// directory of the card, returning false if it is missing or is not in
+// consecutive blocks, and so cannot be streamed. Call it before SD.begin(),
+// with no file open: it opens a volume of its own on the card, and the
+// SD library keeps the block cache of every volume, and the card it reads,
+// in static members shared with its own volume, which SD.begin() sets up
+// again.
+bool streamLocate(Sd2Card* card, const char* name, uint32_t* first, uint32_t* count);
+
+#endif
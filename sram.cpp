@@ -0,0 +1,125 @@
+#include "sram.h"
+
+#ifdef SRAM_REPORT
+
+// Symbols from the linker script and the allocator of avr-libc: the start
+// of SRAM, the end of the static data and bss, the top of the stack, and
+// the top of the heap (0 until something is allocated).
+extern uint8_t __data_start, _end, __stack;
+extern char* __brkval;
+
+void sramPaint() __attribute__((naked, used, section(".init1")));
+
+/*
+	Paints the memory from the end of the bss to the top of the stack. It
+	runs from .init1, before the C runtime has set up the registers the
+	compiler relies on, so it is written in assembly.
+
+	Arguments:
+		None
+
+	Returns:
+		None
+*/
+void sramPaint() {
+	__asm volatile (
+		"    ldi r30, lo8(_end)\n"
+		"    ldi r31, hi8(_end)\n"
+		"    ldi r24, %0\n"
+		"    ldi r25, hi8(__stack)\n"
+		"    rjmp 2f\n"
+		"1:  st Z+, r24\n"
+		"2:  cpi r30, lo8(__stack)\n"
+		"    cpc r31, r25\n"
+		"    brlo 1b\n"
+		"    breq 1b\n"
+		:: "M" (SRAM_PAINT)
+	);
+}
+
+/*
+	Finds the lowest byte above the heap that is no longer painted.
+
+	Arguments:
+		None
+
+	Returns:
+		Pointer to the byte, one past the top of the stack if all are painted
+*/
+static const uint8_t* deepest() {
+	const uint8_t* p = (__brkval != 0) ? (const uint8_t*) __brkval : &_end;
+	while (p <= &__stack && *p == SRAM_PAINT) {
+		p++;
+	}
+	return p;
+}
+
+/*
+	Computes the size of the static data and bss.
+
+	Arguments:
+		None
+
+	Returns:
+		Bytes of static data and bss
+*/
+uint16_t sramStatic() {
+	return &_end - &__data_start;
+}
+
+/*
+	Computes the most stack used since reset.
+
+	Arguments:
+		None
+
+	Returns:
+		Bytes of stack used at the deepest
+*/
+uint16_t sramStackPeak() {
+	return &__stack + 1 - deepest();
+}
+
+/*
+	Computes the memory that has never been used, between the top of the
+	heap and the deepest the stack has reached.
+
+	Arguments:
+		None
+
+	Returns:
+		Bytes never used
+*/
+uint16_t sramHeadroom() {
+	const uint8_t* heap = (__brkval != 0) ? (const uint8_t*) __brkval : &_end;
+	return deepest() - heap;
+}
+
+/*
+	Prints the static data, the stack peak and the headroom over serial
+	when the stack has reached deeper than it had at the last check.
+
+	Arguments:
+		None
+
+	Returns:
+		None
+*/
+void sramTask() {
+	static uint16_t reported = 0;
+
+	uint16_t peak = sramStackPeak();
+	if (peak <= reported) {
+		return;
+	}
+	reported = peak;
+
+	Serial.print(F("sram static="));
+	Serial.print(sramStatic());
+	Serial.print(F(" stack="));
+	Serial.print(peak);
+	Serial.print(F(" headroom="));
+	Serial.println(sramHeadroom());
+}
+
+#endif
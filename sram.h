@@ -0,0 +1,42 @@
+/*
+	Measurement of the SRAM used by the firmware. At reset, before anything
+	else runs, the free memory between the end of the static data and the
+	top of the stack is painted with SRAM_PAINT. The deepest the stack has
+	ever reached is then the lowest byte above the heap that is no longer
+	painted. sramTask() checks it as the program runs and prints a line over
+	serial whenever the stack reaches deeper than before.
+
+	The report is compiled in with -DSRAM_REPORT (make SRAM_REPORT=1), and
+	costs nothing otherwise. "make sram-report" lists the static data and
+	bss of the build by symbol.
+*/
+
+#ifndef _SRAM_H_
+#define _SRAM_H_
+
+#include <Arduino.h>
+
+// byte the free memory is painted with
+#define SRAM_PAINT 0xC5
+
+// milliseconds between checks of the stack
+#define SRAM_CHECK_PERIOD 100
+
+#ifdef SRAM_REPORT
+
+// Bytes of static data and bss.
+uint16_t sramStatic();
+
+// Most bytes of stack used since reset.
+uint16_t sramStackPeak();
+
+// Bytes between the heap and the deepest the stack has reached, which have
+// never been used.
+uint16_t sramHeadroom();
+
+// Print the usage of SRAM when the stack has reached deeper than before.
+void sramTask();
+
+#endif
+
+#endif
@@ -0,0 +1,89 @@
+#include "tiles.h"
+
+/*
+	Makes sure the given block of the marker table is in the cache. The
+	table was found at start up, so unlike readIndexBlock() a failed read is
+	retried, as for the blocks of restaurants.
+
+	Arguments:
+		block (uint32_t): block of the card to read
+		card (Sd2Card*): pointer to SD card
+		cache (RestCache*): pointer to cache of restaurant structs, which holds the block
+
+	Returns:
+		true if the block is in the cache
+*/
+static bool readMarkerBlock(uint32_t block, Sd2Card* card, RestCache* cache) {
+	return fillCache(block, true, card, cache);
+}
+
+/*
+	Checks for the header block of the marker table, which an older card
+	written without host/cardbuild does not have.
+
+	Arguments:
+		card (Sd2Card*): pointer to SD card
+		cache (RestCache*): pointer to cache of restaurant structs, which holds the block
+
+	Returns:
+		true if the card holds a marker table, false otherwise
+*/
+bool markerTableFound(Sd2Card* card, RestCache* cache) {
+	if (!readIndexBlock(MARKER_TABLE_BLOCK, card, cache)) {
+		return false;
+	}
+	uint32_t magic;
+	memcpy(&magic, cachedData(cache), sizeof(magic));
+	return magic == MARKER_TABLE_MAGIC;
+}
+
+/*
+	Passes the marker of every tile overlapping an area of the map to a
+	visitor, reading the grid of the zoom level and rating a row of tiles at
+	a time. A row is at most a block, so each block is read once.
+
+	Arguments:
+		mv (const MapView&): pass-by-reference to current map view
+		width (int16_t): width of the area, from the upper-left of the view
+		height (int16_t): height of the area
+		rateSelect (int): minimum rating of restaurant desired
+		visit (TileVisitor): called with each tile holding a restaurant
+		ctx (void*): passed on to the visitor
+		card (Sd2Card*): pointer to SD card
+		cache (RestCache*): pointer to cache of restaurant structs, which holds the blocks
+
+	Returns:
+		true if every block was read, false otherwise
+*/
+bool getTileMarkers(const MapView& mv, int16_t width, int16_t height, int rateSelect, TileVisitor visit, void* ctx,
+                    Sd2Card* card, RestCache* cache) {
+	int16_t cols = MARKER_TILES_X(mv.zoom);
+
+	// range of tiles overlapping the area
+	int16_t tx0 = max(mv.mapX, 0) >> MARKER_SHIFT;
+	int16_t ty0 = max(mv.mapY, 0) >> MARKER_SHIFT;
+	int16_t tx1 = min((mv.mapX + width - 1) >> MARKER_SHIFT, cols - 1);
+	int16_t ty1 = min((mv.mapY + height - 1) >> MARKER_SHIFT, MARKER_TILES_Y(mv.zoom) - 1);
+
+	uint32_t grid = markerGridBlock(mv.zoom, constrain(rateSelect, 1, MARKER_RATINGS));
+	uint32_t held = 0;
+
+	for (int16_t ty = ty0; ty <= ty1; ++ty) {
+		for (int16_t tx = tx0; tx <= tx1; ++tx) {
+			uint16_t t = (uint16_t) ty * cols + tx;
+			uint32_t block = grid + t / MARKER_BLOCK_ENTRIES;
+			if (block != held) {
+				if (!readMarkerBlock(block, card, cache)) {
+					return false;
+				}
+				held = block;
+			}
+
+			const TileMarker& m = ((const TileMarker*) cachedData(cache))[t % MARKER_BLOCK_ENTRIES];
+			if (m.count > 0) {
+				visit((tx << MARKER_SHIFT) + m.meanX, (ty << MARKER_SHIFT) + m.meanY, m.count, ctx);
+			}
+		}
+	}
+	return true;
+}
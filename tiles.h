@@ -0,0 +1,79 @@
+/*
+	Per-tile spatial bucketing of the restaurants, used to draw one cluster
+	marker per tile of the map instead of one dot per restaurant.
+
+	The buckets are in the marker table, written after the near table by
+	host/cardbuild. For each zoom level and minimum rating it holds a grid
+	of the tiles of the map at that level, MARKER_TILE pixels square, with
+	the number of restaurants in each and their mean position, so markers
+	merge within the same distance on the screen at every zoom level. A
+	header block comes first, then the grids by zoom level and then by
+	rating. Drawing the markers reads the blocks of the rows of tiles in
+	view rather than every restaurant on the card.
+*/
+
+#ifndef _TILES_H_
+#define _TILES_H_
+
+#include <Arduino.h>
+#include <SD.h>
+#include "restaurant.h"
+#include "neartable.h"
+#include "yegmap.h"
+
+// The table starts at the first block after the near table.
+#define MARKER_TABLE_BLOCK (NEAR_TABLE_BLOCK + (uint32_t) NEAR_RATINGS * NEAR_CELLS * NEAR_CELLS * NEAR_SLOT_BLOCKS)
+
+// "MARK" as a little-endian integer, the start of the header block.
+#define MARKER_TABLE_MAGIC 0x4B52414DUL
+
+// Tiles are MARKER_TILE pixels square at every zoom level.
+#define MARKER_SHIFT 5
+#define MARKER_TILE  (1 << MARKER_SHIFT)
+#define MARKER_TILES_X(z) (MAPWIDTH_AT(z) >> MARKER_SHIFT)
+#define MARKER_TILES_Y(z) (MAPHEIGHT_AT(z) >> MARKER_SHIFT)
+
+// Minimum ratings there are grids for, 1 to MARKER_RATINGS stars.
+#define MARKER_RATINGS 5
+
+// The restaurants of at least a rating in one tile: how many there are,
+// and their mean position in pixels of the zoom level from the upper-left
+// of the tile.
+struct TileMarker {
+  uint16_t count;
+  uint8_t meanX, meanY;
+};
+
+#define MARKER_BLOCK_ENTRIES (512 / sizeof(TileMarker))
+
+// Blocks of the grid of one zoom level and rating, a whole number since
+// each is a power of two tiles.
+#define MARKER_GRID_BLOCKS(z) ((uint32_t) MARKER_TILES_X(z) * MARKER_TILES_Y(z) / MARKER_BLOCK_ENTRIES)
+
+// Blocks of the whole table, with its header.
+#define MARKER_TABLE_BLOCKS (1 + MARKER_RATINGS * (MARKER_GRID_BLOCKS(0) + MARKER_GRID_BLOCKS(1) + MARKER_GRID_BLOCKS(2)))
+
+// The first block of the grid of the zoom level and minimum rating.
+inline uint32_t markerGridBlock(uint8_t zoom, int rating) {
+  uint32_t block = MARKER_TABLE_BLOCK + 1;
+  for (uint8_t z = 0; z < zoom; z++) {
+    block += MARKER_RATINGS * MARKER_GRID_BLOCKS(z);
+  }
+  return block + (rating - 1) * MARKER_GRID_BLOCKS(zoom);
+}
+
+// Called with the position of a marker, in pixels of the map at the zoom
+// level, and the number of restaurants it stands for.
+typedef void (*TileVisitor)(int16_t x, int16_t y, uint16_t count, void* ctx);
+
+// Returns true if the card holds a marker table.
+bool markerTableFound(Sd2Card* card, RestCache* cache);
+
+// Pass the marker of every tile overlapping the area of the map at the
+// zoom level of mv, width by height pixels from its upper-left, that holds
+// a restaurant of at least the rating. Returns false if a block could not
+// be read.
+bool getTileMarkers(const MapView& mv, int16_t width, int16_t height, int rateSelect, TileVisitor visit, void* ctx,
+                    Sd2Card* card, RestCache* cache);
+
+#endif
@@ -0,0 +1,76 @@
+#include "trace.h"
+
+const char* const traceStageNames[NUM_TRACE_STAGES] = {
+	"getRestaurant", "readBlock", "lcd_image_draw", "sort", "printRestaurant"
+};
+
+#ifdef TRACE
+
+struct TraceRecord {
+	uint8_t stage;
+	uint32_t start, duration;
+};
+
+// Records are added at head and sent from tail.
+TraceRecord traceRing[TRACE_RING_SIZE];
+uint8_t traceHead, traceTail;
+uint32_t traceDropped;
+
+/*
+	Adds a record to the ring buffer. If the buffer is full the record is
+	dropped and counted, and the count is sent once there is room again.
+
+	Arguments:
+		stage (uint8_t): the TraceStage being timed
+		start (uint32_t): micros() when the stage started
+		duration (uint32_t): microseconds the stage took
+
+	Returns:
+		None
+*/
+void traceRecord(uint8_t stage, uint32_t start, uint32_t duration) {
+	if ((uint8_t) (traceHead - traceTail) >= TRACE_RING_SIZE) {
+		traceDropped++;
+		return;
+	}
+
+	if (traceDropped > 0 && (uint8_t) (traceHead - traceTail) < TRACE_RING_SIZE - 1) {
+		TraceRecord& d = traceRing[traceHead++ % TRACE_RING_SIZE];
+		d.stage = TRACE_DROPPED;
+		d.start = start;
+		d.duration = traceDropped;
+		traceDropped = 0;
+	}
+
+	TraceRecord& r = traceRing[traceHead++ % TRACE_RING_SIZE];
+	r.stage = stage;
+	r.start = start;
+	r.duration = duration;
+}
+
+/*
+	Sends records from the ring buffer over serial for as long as they fit
+	in the transmit buffer without waiting.
+
+	Arguments:
+		None
+
+	Returns:
+		None
+*/
+void traceTask() {
+	while (traceTail != traceHead && Serial.availableForWrite() >= TRACE_RECORD_BYTES) {
+		const TraceRecord& r = traceRing[traceTail % TRACE_RING_SIZE];
+		uint8_t buf[TRACE_RECORD_BYTES] = {
+			TRACE_SYNC, r.stage,
+			(uint8_t) r.start, (uint8_t) (r.start >> 8),
+			(uint8_t) (r.start >> 16), (uint8_t) (r.start >> 24),
+			(uint8_t) r.duration, (uint8_t) (r.duration >> 8),
+			(uint8_t) (r.duration >> 16), (uint8_t) (r.duration >> 24)
+		};
+		Serial.write(buf, TRACE_RECORD_BYTES);
+		traceTail++;
+	}
+}
+
+#endif
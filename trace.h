@@ -0,0 +1,69 @@
+/*
+	Lightweight instrumentation of the hot paths. A scoped timer records the
+	start and duration (from micros()) of each traced stage into a ring
+	buffer, which traceTask() drains over serial as a compact binary trace
+	only while the serial transmit buffer has room, so tracing never waits
+	on the port. host/tracedecode turns a captured trace into per-stage
+	histograms.
+
+	Tracing is compiled in with -DTRACE (make TRACE=1), and costs nothing
+	otherwise.
+*/
+
+#ifndef _TRACE_H_
+#define _TRACE_H_
+
+#include <Arduino.h>
+
+// The traced stages.
+enum TraceStage {
+  TRACE_GET_RESTAURANT,
+  TRACE_READ_BLOCK,
+  TRACE_IMAGE_DRAW,
+  TRACE_SORT,
+  TRACE_PRINT_RESTAURANT,
+  NUM_TRACE_STAGES,
+  TRACE_DROPPED = 0xFF // record holding the number of records dropped
+};
+
+// Number of records the ring buffer holds, a power of two.
+#define TRACE_RING_SIZE 32
+
+// Each record goes over serial as TRACE_SYNC, the stage, then the start and
+// duration in microseconds as 32 bit little-endian integers.
+#define TRACE_SYNC 0xA5
+#define TRACE_RECORD_BYTES 10
+
+// Names of the stages, for the decoder.
+extern const char* const traceStageNames[NUM_TRACE_STAGES];
+
+#ifdef TRACE
+
+// Add a record to the ring buffer, dropping it if the buffer is full.
+void traceRecord(uint8_t stage, uint32_t start, uint32_t duration);
+
+// Send as many records as fit in the serial transmit buffer.
+void traceTask();
+
+// Records the time from its construction to the end of its scope.
+class TraceScope {
+public:
+  TraceScope(uint8_t stage) : stage(stage), start(micros()) {}
+  ~TraceScope() { traceRecord(stage, start, micros() - start); }
+
+private:
+  uint8_t stage;
+  uint32_t start;
+};
+
+#define TRACE_SCOPE(stage) TraceScope traceScope(stage)
+#define TRACE_RECORD(stage, start, duration) traceRecord(stage, start, duration)
+
+#else
+
+#define TRACE_SCOPE(stage)
+#define TRACE_RECORD(stage, start, duration)
+
+#endif
+
+#endif
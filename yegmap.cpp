@@ -1,20 +1,25 @@
 #include "yegmap.h"
 
 // These will convert between pixel coordiantes on the yeg-big.lcd map
-// and geographic coordinates. They are from the assignment description.
+// and geographic coordinates. They are from the assignment description,
+// extended to take the zoom level of the map pyramid into account.
 
-int32_t x_to_lon(int16_t x) {
-  return map(x, 0, MAPWIDTH, LONWEST, LONEAST);
+int32_t x_to_lon(int16_t x, uint8_t zoom) {
+  return map(x, 0, MAPWIDTH_AT(zoom), LONWEST, LONEAST);
 }
 
-int32_t y_to_lat(int16_t y) {
-  return map(y, 0, MAPHEIGHT, LATNORTH, LATSOUTH);
+int32_t y_to_lat(int16_t y, uint8_t zoom) {
+  return map(y, 0, MAPHEIGHT_AT(zoom), LATNORTH, LATSOUTH);
 }
 
-int16_t lon_to_x(int32_t lon) {
-  return map(lon, LONWEST, LONEAST, 0, MAPWIDTH);
+int16_t lon_to_x(int32_t lon, uint8_t zoom) {
+  return map(lon, LONWEST, LONEAST, 0, MAPWIDTH_AT(zoom));
 }
 
-int16_t lat_to_y(int32_t lat) {
-  return map(lat, LATNORTH, LATSOUTH, 0, MAPHEIGHT);
+int16_t lat_to_y(int32_t lat, uint8_t zoom) {
+  return map(lat, LATNORTH, LATSOUTH, 0, MAPHEIGHT_AT(zoom));
+}
+
+int16_t rezoom(int16_t p, uint8_t from, uint8_t to) {
+  return ((int32_t) p << from) >> to;
 }
@@ -6,11 +6,12 @@
 #ifndef _YEG_MAP_H_
 #define _YEG_MAP_H_
 
-#include "lcd_image.h"
+#include <Arduino.h>
 
 struct MapView {
 	int16_t cursorX, cursorY; // cursor pixel position on the screen
 	int16_t mapX, mapY;       // upper-left pixel of the .lcd to display
+	uint8_t zoom;             // level of the map pyramid being displayed
 };
 
 #define MAPWIDTH  2048
@@ -20,10 +21,21 @@ struct MapView {
 #define LONWEST   -11368652l
 #define LONEAST   -11333496l
 
+// The map is stored as a pyramid of images, level z being the full size map
+// halved z times (2048, 1024 and 512 pixels square).
+#define NUM_ZOOM_LEVELS 3
+#define MAPWIDTH_AT(z)  (MAPWIDTH >> (z))
+#define MAPHEIGHT_AT(z) (MAPHEIGHT >> (z))
+
 // Conversion routines to convert between x/y and lon/lat coordinates
-int32_t x_to_lon(int16_t x);
-int32_t y_to_lat(int16_t y);
-int16_t lon_to_x(int32_t lon);
-int16_t lat_to_y(int32_t lat);
+// on the map at the given zoom level.
+int32_t x_to_lon(int16_t x, uint8_t zoom = 0);
+int32_t y_to_lat(int16_t y, uint8_t zoom = 0);
+int16_t lon_to_x(int32_t lon, uint8_t zoom = 0);
+int16_t lat_to_y(int32_t lat, uint8_t zoom = 0);
+
+// Converts a pixel coordinate on the map at one zoom level to the
+// same point on the map at another zoom level.
+int16_t rezoom(int16_t p, uint8_t from, uint8_t to);
 
 #endif